@@ -38,18 +38,15 @@ uint64_t perft(Position& pos, uint8_t depth) {
 
   if (depth == 0) return 1;
 
-  uint64_t nodes = 0;
-  MoveGenerator move_gen;
-
+  MoveList move_gen;
   move_gen.generate(pos);
 
+  // Every generated move is legal, so the last ply is just the move count
+  if (depth == 1) return move_gen.count;
+
+  uint64_t nodes = 0;
   for (int i = 0; i < move_gen.count; i++) {
-    pos.make_move(move_gen.move_list[i]);
-    uint8_t king_square = get_lsbit_index(pos.all_piece_bitboards[BLACK_KING - pos.side_to_move]);
-    if (move_gen.is_square_attacked(pos, king_square, pos.side_to_move ^ 1)) {
-      pos.unmake_move();
-      continue;
-    }
+    pos.make_move(move_gen.moves[i].move);
     nodes += perft(pos,depth-1);
     pos.unmake_move();
   }
@@ -58,22 +55,15 @@ uint64_t perft(Position& pos, uint8_t depth) {
 }
 
 void divide(Position& pos, uint8_t depth) {
-    MoveGenerator move_gen;
+    MoveList move_gen;
     move_gen.generate(pos);
 
     uint64_t total = 0;
 
     for (int i = 0; i < move_gen.count; i++) {
-        Move move = move_gen.move_list[i];
+        Move move = move_gen.moves[i].move;
         
         pos.make_move(move);
-        
-        // Legality Check
-        uint8_t king_sq = get_lsbit_index(pos.all_piece_bitboards[BLACK_KING - pos.side_to_move]);
-        if (move_gen.is_square_attacked(pos, king_sq, pos.side_to_move ^ 1)) {
-            pos.unmake_move();
-            continue;
-        }
 
         // Recursively count nodes for this branch
         uint64_t branch_nodes = perft(pos, depth - 1);
@@ -0,0 +1,94 @@
+#include "attack_info.h"
+#include <array>
+#include <cstdint>
+#include "move_utility.h"
+#include "piece.h"
+#include "position.h"
+
+using namespace MoveUtility;
+
+namespace {
+
+void compute_side(const Position& pos, uint8_t color, std::array<uint64_t, 6>& attacks) {
+  uint64_t pawns = pos.all_piece_bitboards[WHITE_PAWN + color];
+  uint64_t pushed = color == WHITE ? pawns << 8 : pawns >> 8;
+  attacks[PAWN] = ((pushed << 1) & ~FILE_A) | ((pushed >> 1) & ~FILE_H);
+
+  attacks[KNIGHT] = 0;
+  uint64_t knights = pos.all_piece_bitboards[WHITE_KNIGHT + color];
+  while (knights) {
+    attacks[KNIGHT] |= KNIGHT_MOVES[get_lsbit_index(knights)];
+    knights &= knights - 1;
+  }
+
+  attacks[BISHOP] = 0;
+  uint64_t bishops = pos.all_piece_bitboards[WHITE_BISHOP + color];
+  while (bishops) {
+    attacks[BISHOP] |= get_bishop_attacks(get_lsbit_index(bishops), pos.total_bb);
+    bishops &= bishops - 1;
+  }
+
+  attacks[ROOK] = 0;
+  uint64_t rooks = pos.all_piece_bitboards[WHITE_ROOK + color];
+  while (rooks) {
+    attacks[ROOK] |= get_rook_attacks(get_lsbit_index(rooks), pos.total_bb);
+    rooks &= rooks - 1;
+  }
+
+  attacks[QUEEN] = 0;
+  uint64_t queens = pos.all_piece_bitboards[WHITE_QUEEN + color];
+  while (queens) {
+    uint8_t square = get_lsbit_index(queens);
+    attacks[QUEEN] |= get_bishop_attacks(square, pos.total_bb) | get_rook_attacks(square, pos.total_bb);
+    queens &= queens - 1;
+  }
+
+  attacks[KING] = KING_MOVES[get_lsbit_index(pos.all_piece_bitboards[WHITE_KING + color])];
+}
+
+}
+
+void AttackInfo::compute(const Position& pos) {
+  uint8_t Us = pos.side_to_move;
+  uint8_t Them = Us ^ 1;
+
+  for (uint8_t color : {WHITE, BLACK}) {
+    compute_side(pos, color, by_piece[color]);
+    by_side[color] = 0;
+    for (uint64_t attacks : by_piece[color]) by_side[color] |= attacks;
+  }
+
+  king_square = get_lsbit_index(pos.all_piece_bitboards[WHITE_KING + Us]);
+  uint64_t rook_rays = get_rook_attacks(king_square, pos.total_bb);
+  uint64_t bishop_rays = get_bishop_attacks(king_square, pos.total_bb);
+  uint64_t their_rooks = pos.all_piece_bitboards[WHITE_ROOK + Them] | pos.all_piece_bitboards[WHITE_QUEEN + Them];
+  uint64_t their_bishops = pos.all_piece_bitboards[WHITE_BISHOP + Them] | pos.all_piece_bitboards[WHITE_QUEEN + Them];
+  uint64_t slider_checkers = (rook_rays & their_rooks) | (bishop_rays & their_bishops);
+  checkers = slider_checkers | (PAWN_ATTACKS[Us][king_square] & pos.all_piece_bitboards[WHITE_PAWN + Them]) |
+             (KNIGHT_MOVES[king_square] & pos.all_piece_bitboards[WHITE_KNIGHT + Them]);
+
+  // A checking slider also covers the squares behind the king on its line
+  king_danger = by_side[Them];
+  while (slider_checkers) {
+    uint8_t checker_sq = get_lsbit_index(slider_checkers);
+    slider_checkers &= slider_checkers - 1;
+    king_danger |= LINE[checker_sq][king_square] & ~(1ULL << checker_sq);
+  }
+
+  // Enemy sliders that would hit the king if our pieces were removed
+  uint64_t snipers = (get_rook_attacks(king_square, pos.occupancy_bitboards[Them]) & their_rooks) |
+                     (get_bishop_attacks(king_square, pos.occupancy_bitboards[Them]) & their_bishops);
+
+  pinned = 0;
+  while (snipers) {
+    uint8_t sniper_sq = get_lsbit_index(snipers);
+    snipers &= snipers - 1;
+    uint64_t blockers = BETWEEN[king_square][sniper_sq] & pos.total_bb;
+    if (count_bits(blockers) == 1) pinned |= blockers & pos.occupancy_bitboards[Us];
+  }
+
+  check_mask = ~0ULL;
+  if (checkers) check_mask = checkers | BETWEEN[king_square][get_lsbit_index(checkers)];
+
+  valid = true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include "position.h"
+
+// Squares attacked by each side and the side to move's checks and pins, computed in one pass over
+// both sides' pieces. Each search ply keeps one, shared by move generation, the legality tests of
+// hash moves and killers and, in time, evaluation terms, so most attack questions are a single AND.
+struct AttackInfo {
+  // [color][piece kind]
+  std::array<std::array<uint64_t, 6>, 2> by_piece;
+  // [color], union of by_piece
+  std::array<uint64_t, 2> by_side;
+  // Squares the side to move's king can't step to: enemy attacks with the king taken off the board
+  uint64_t king_danger;
+
+  uint8_t king_square;
+  uint64_t checkers;
+  uint64_t pinned;
+  // Squares that block or capture a single checker, every square when not in check
+  uint64_t check_mask;
+
+  // Cleared by the owner whenever its position changes
+  bool valid = false;
+
+  void compute(const Position& pos);
+
+  inline void update(const Position& pos) {
+    if (!valid) compute(pos);
+  }
+};
@@ -0,0 +1,160 @@
+#include "bench.h"
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "nnue.h"
+#include "position.h"
+#include "search.h"
+#include "thread_pool.h"
+#include "transposition_table.h"
+
+namespace {
+
+// Limit of the back to back node limited searches run with several threads
+constexpr uint64_t NODE_LIMIT_CHECK = 200'000;
+
+// Openings, middlegames with both kings under attack, and endgames down to a few pieces
+const std::vector<std::string> BENCH_POSITIONS = {
+  "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+  "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+  "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+  "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+  "rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14",
+  "r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",
+  "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+  "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+  "r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",
+  "4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",
+  "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+  "r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",
+  "3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
+  "r1q2rk1/2p1bppp/2Pp4/p6b/Q1PNp3/4B3/PP1R1PPP/2K4R w - - 2 18",
+  "4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22",
+  "3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",
+  "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+  "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+  "r3k2r/3nnpbp/q2pp1p1/p7/Pp1PPPP1/4BNN1/1P5P/R2Q1RK1 w kq - 0 16",
+  "3Qb1k1/1r2ppb1/pN1n2q1/Pp1Pp1Pr/4P2p/4BP2/4B1R1/1R5K b - - 11 40",
+  "4k3/3q1r2/1N2r1b1/3ppN2/2nPP3/1B1R2n1/2R1Q3/3K4 w - - 5 1",
+  "5rk1/q6p/2p3bR/1pPp1rP1/1P1Pp3/P3B1Q1/1K3P2/R7 w - - 93 90",
+  "4rrk1/1p1nq3/p7/2p1P1pp/3P2bp/3Q1Bn1/PPPB4/1K2R1NR w - - 40 21",
+  "6k1/3b3r/1p1p4/p1n2p2/1PPNpP1q/P3Q1p1/1R1RB1P1/5K2 b - - 0 1",
+  "r2r1n2/pp2bk2/2p1p2p/3q4/3PN1QP/2P3R1/P4PP1/5RK1 w - - 0 1",
+  "1r3k2/4q3/2Pp3b/3Bp3/2Q2p2/1p1P2P1/1P2KP2/3N4 w - - 0 1",
+  "6k1/4pp1p/3p2p1/P1pPb3/R7/1r2P1PP/3B1P2/6K1 w - - 0 1",
+  "6k1/6p1/P6p/r1N5/5p2/7P/1b3PP1/4R1K1 w - - 0 1",
+  "8/pp2r1k1/2p1p3/3pP2p/1P1P1P1P/P5KR/8/8 w - - 0 1",
+  "8/3p4/p1bk3p/Pp6/1Kp1PpPp/2P2P1P/2P5/5B2 b - - 0 1",
+  "6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/8 b - - 0 1",
+  "8/2p5/8/2kPKp1p/2p4P/2P5/3P4/8 w - - 0 1",
+  "5k2/7R/4P2p/5K2/p1r2P1p/8/8/8 b - - 0 1",
+  "8/3p3B/5p2/5P2/p7/PP5b/k7/6K1 w - - 0 1",
+  "8/R7/2q5/8/6k1/8/1P5p/K6R w - - 0 124",
+  "8/8/1P6/5pr1/8/4R3/7k/2K5 w - - 0 1",
+  "8/2p4P/8/kr6/6R1/8/8/1K6 w - - 0 1",
+  "8/8/3P3k/8/1p6/8/1P6/1K3n2 b - - 0 1",
+  "8/8/8/8/5kp1/P7/8/1K1N4 w - - 0 1",
+  "8/8/8/5N2/8/p7/8/2NK3k w - - 0 1"
+};
+
+// EPD records have the first four FEN fields followed by operations, the clocks are optional
+std::string epd_to_fen(const std::string& line) {
+  std::istringstream stream(line);
+  std::vector<std::string> fields;
+  std::string field;
+  while (fields.size() < 6 && stream >> field) fields.push_back(field);
+  if (fields.size() < 4) return "";
+
+  std::string fen = fields[0] + " " + fields[1] + " " + fields[2] + " " + fields[3];
+  bool has_clocks = fields.size() == 6 && fields[4].find_first_not_of("0123456789") == std::string::npos
+                    && fields[5].find_first_not_of("0123456789") == std::string::npos;
+  return fen + (has_clocks ? " " + fields[4] + " " + fields[5] : " 0 1");
+}
+
+std::vector<std::string> load_epd(const std::string& epd_file) {
+  std::vector<std::string> fens;
+  std::ifstream file(epd_file);
+  if (!file) {
+    std::cerr << "Can't open " << epd_file << std::endl;
+    return fens;
+  }
+
+  std::string line;
+  while (std::getline(file, line)) {
+    std::string fen = epd_to_fen(line);
+    if (!fen.empty()) fens.push_back(fen);
+  }
+  return fens;
+}
+
+}
+
+namespace Bench {
+
+void run(uint8_t depth, size_t threads, const std::string& epd_file) {
+  std::vector<std::string> fens = epd_file.empty() ? BENCH_POSITIONS : load_epd(epd_file);
+
+  Threads.set_threads(threads);
+  SearchLimits limits;
+  limits.depth = depth;
+
+  std::cout << "Evaluation: " << (NNUE::is_active() ? "NNUE " + NNUE::loaded_file() : "PST") << "\n" << std::endl;
+
+  uint64_t total_nodes = 0;
+  uint64_t cache_hits = 0;
+  uint64_t cache_probes = 0;
+  auto start = std::chrono::steady_clock::now();
+
+  for (size_t i = 0; i < fens.size(); i++) {
+    Position pos(fens[i]);
+    TT.clear();
+    Threads.clear_history();
+
+    Threads.search(pos, limits);
+    uint64_t nodes = Threads.nodes_searched();
+    total_nodes += nodes;
+
+    uint64_t hits, misses;
+    Threads.eval_cache_stats(hits, misses);
+    cache_hits += hits;
+    cache_probes += hits + misses;
+
+    std::cout << "Position " << i + 1 << "/" << fens.size() << " (" << fens[i] << "): " << nodes << std::endl;
+  }
+
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  uint64_t elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+
+  std::cout << "\n==========================="
+            << "\nTotal time (ms) : " << elapsed_ms
+            << "\nNodes searched  : " << total_nodes
+            << "\nNodes/second    : " << total_nodes * 1000 / (elapsed_ms ? elapsed_ms : 1)
+            << "\nEval cache hits : " << cache_hits * 100 / (cache_probes ? cache_probes : 1) << "%" << std::endl;
+
+  // Node counts left over from the previous search must not count towards the next one's limit:
+  // after a larger search, the first iteration of a smaller one has to report its own nodes only
+  // and the search has to go on to reach its limit
+  if (threads > 1) {
+    uint64_t first_iteration_nodes = 0;
+    Threads.set_iteration_callback([&](const Search&) {
+      if (!first_iteration_nodes) first_iteration_nodes = Threads.nodes_searched();
+    });
+
+    SearchLimits node_limit;
+    node_limit.nodes = 4 * NODE_LIMIT_CHECK;
+    Threads.search(Position(), node_limit);
+    first_iteration_nodes = 0;
+    node_limit.nodes = NODE_LIMIT_CHECK;
+    Threads.search(Position(), node_limit);
+    Threads.set_iteration_callback(nullptr);
+
+    bool ok = first_iteration_nodes < NODE_LIMIT_CHECK && Threads.nodes_searched() >= NODE_LIMIT_CHECK;
+    std::cout << "Node limit      : " << (ok ? "ok" : "FAILED, counted an earlier search's nodes") << std::endl;
+  }
+}
+
+} // namespace Bench
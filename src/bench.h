@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Bench {
+
+constexpr uint8_t DEFAULT_DEPTH = 11;
+
+// Searches every position to depth, each with an empty transposition table and history, and
+// prints the total node count and speed. With one thread the node count is a signature of the
+// search: it only changes when the search does. Positions come from epd_file when it isn't empty.
+// With several threads it also checks that back to back node limited searches each reach the limit.
+void run(uint8_t depth, size_t threads, const std::string& epd_file);
+
+} // namespace Bench
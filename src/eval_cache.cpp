@@ -0,0 +1,11 @@
+#include "eval_cache.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+EvalCache::EvalCache() : entries(ENTRY_COUNT, 0) {}
+
+void EvalCache::clear() {
+  std::fill(entries.begin(), entries.end(), 0);
+  reset_stats();
+}
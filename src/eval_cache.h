@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Static evaluations by Zobrist key, direct mapped and owned by one search thread. The low bits of
+// the key pick the slot, the upper 32 are stored next to the score to verify a hit. Only for the
+// side to move's score of one evaluator, cleared when the evaluation changes.
+class EvalCache {
+
+public:
+
+  EvalCache();
+
+  void clear();
+
+  // Fills eval and returns true on a hit
+  inline bool probe(uint64_t key, int32_t& eval) {
+    uint64_t entry = entries[key & (ENTRY_COUNT - 1)];
+    if ((entry ^ key) >> 32) {
+      misses++;
+      return false;
+    }
+    hits++;
+    eval = (int32_t)(uint32_t)entry;
+    return true;
+  }
+
+  inline void store(uint64_t key, int32_t eval) {
+    entries[key & (ENTRY_COUNT - 1)] = (key & 0xFFFFFFFF00000000ULL) | (uint32_t)eval;
+  }
+
+  // Since the last reset_stats
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+
+  inline void reset_stats() {
+    hits = 0;
+    misses = 0;
+  }
+
+private:
+
+  static constexpr size_t ENTRY_COUNT = 1 << 17;
+  std::vector<uint64_t> entries;
+
+};
@@ -1,12 +1,13 @@
 #include "evaluation.h"
 #include "move_utility.h"
+#include "pawns.h"
 #include "piece.h"
 #include <cstdint>
 #include <array>
 
 namespace {
 
-const std::array<int, 64> mg_pawn_table = {
+constexpr std::array<int, 64> mg_pawn_table = {
       0,   0,   0,   0,   0,   0,  0,   0,
      98, 134,  61,  95,  68, 126, 34, -11,
      -6,   7,  26,  31,  65,  56, 25, -20,
@@ -17,7 +18,7 @@ const std::array<int, 64> mg_pawn_table = {
       0,   0,   0,   0,   0,   0,  0,   0,
 };
 
-const std::array<int, 64> eg_pawn_table = {
+constexpr std::array<int, 64> eg_pawn_table = {
       0,   0,   0,   0,   0,   0,   0,   0,
     178, 173, 158, 134, 147, 132, 165, 187,
      94, 100,  85,  67,  56,  53,  82,  84,
@@ -28,7 +29,7 @@ const std::array<int, 64> eg_pawn_table = {
       0,   0,   0,   0,   0,   0,   0,   0,
 };
 
-const std::array<int, 64> mg_knight_table = {
+constexpr std::array<int, 64> mg_knight_table = {
     -167, -89, -34, -49,  61, -97, -15, -107,
      -73, -41,  72,  36,  23,  62,   7,  -17,
      -47,  60,  37,  65,  84, 129,  73,   44,
@@ -39,7 +40,7 @@ const std::array<int, 64> mg_knight_table = {
     -105, -21, -58, -33, -17, -28, -19,  -23,
 };
 
-const std::array<int, 64> eg_knight_table = {
+constexpr std::array<int, 64> eg_knight_table = {
     -58, -38, -13, -28, -31, -27, -63, -99,
     -25,  -8, -25,  -2,  -9, -25, -24, -52,
     -24, -20,  10,   9,  -1,  -9, -19, -41,
@@ -50,7 +51,7 @@ const std::array<int, 64> eg_knight_table = {
     -29, -51, -23, -15, -22, -18, -50, -64,
 };
 
-const std::array<int, 64> mg_bishop_table = {
+constexpr std::array<int, 64> mg_bishop_table = {
     -29,   4, -82, -37, -25, -42,   7,  -8,
     -26,  16, -18, -13,  30,  59,  18, -47,
     -16,  37,  43,  40,  35,  50,  37,  -2,
@@ -61,7 +62,7 @@ const std::array<int, 64> mg_bishop_table = {
     -33,  -3, -14, -21, -13, -12, -39, -21,
 };
 
-const std::array<int, 64> eg_bishop_table = {
+constexpr std::array<int, 64> eg_bishop_table = {
     -14, -21, -11,  -8, -7,  -9, -17, -24,
      -8,  -4,   7, -12, -3, -13,  -4, -14,
       2,  -8,   0,  -1, -2,   6,   0,   4,
@@ -72,7 +73,7 @@ const std::array<int, 64> eg_bishop_table = {
     -23,  -9, -23,  -5, -9, -16,  -5, -17,
 };
 
-const std::array<int, 64> mg_rook_table = {
+constexpr std::array<int, 64> mg_rook_table = {
      32,  42,  32,  51, 63,  9,  31,  43,
      27,  32,  58,  62, 80, 67,  26,  44,
      -5,  19,  26,  36, 17, 45,  61,  16,
@@ -83,7 +84,7 @@ const std::array<int, 64> mg_rook_table = {
     -19, -13,   1,  17, 16,  7, -37, -26,
 };
 
-const std::array<int, 64> eg_rook_table = {
+constexpr std::array<int, 64> eg_rook_table = {
     13, 10, 18, 15, 12,  12,   8,   5,
     11, 13, 13, 11, -3,   3,   8,   3,
      7,  7,  7,  5,  4,  -3,  -5,  -3,
@@ -94,7 +95,7 @@ const std::array<int, 64> eg_rook_table = {
     -9,  2,  3, -1, -5, -13,   4, -20,
 };
 
-const std::array<int, 64> mg_queen_table = {
+constexpr std::array<int, 64> mg_queen_table = {
     -28,   0,  29,  12,  59,  44,  43,  45,
     -24, -39,  -5,   1, -16,  57,  28,  54,
     -13, -17,   7,   8,  29,  56,  47,  57,
@@ -105,7 +106,7 @@ const std::array<int, 64> mg_queen_table = {
      -1, -18,  -9,  10, -15, -25, -31, -50,
 };
 
-const std::array<int, 64> eg_queen_table = {
+constexpr std::array<int, 64> eg_queen_table = {
      -9,  22,  22,  27,  27,  19,  10,  20,
     -17,  20,  32,  41,  58,  25,  30,   0,
     -20,   6,   9,  49,  47,  35,  19,   9,
@@ -116,7 +117,7 @@ const std::array<int, 64> eg_queen_table = {
     -33, -28, -22, -43,  -5, -32, -20, -41,
 };
 
-const std::array<int, 64> mg_king_table = {
+constexpr std::array<int, 64> mg_king_table = {
     -65,  23,  16, -15, -56, -34,   2,  13,
      29,  -1, -20,  -7,  -8,  -4, -38, -29,
      -9,  24,   2, -16, -20,   6,  22, -22,
@@ -127,7 +128,7 @@ const std::array<int, 64> mg_king_table = {
     -15,  36,  12, -54,   8, -28,  24,  14,
 };
 
-const std::array<int, 64> eg_king_table = {
+constexpr std::array<int, 64> eg_king_table = {
     -74, -35, -18, -18, -11,  15,   4, -17,
     -12,  17,  14,  17,  17,  38,  23,  11,
      10,  17,  23,  15,  20,  45,  44,  13,
@@ -138,11 +139,10 @@ const std::array<int, 64> eg_king_table = {
     -53, -34, -21, -11, -28, -14, -24, -43
 };
 
-const std::array<int, 6> MG_PIECE_VALUES = {82, 337, 365, 477, 1025, 0};
-const std::array<int, 6> EG_PIECE_VALUES = {94, 281, 297, 512, 936, 0};
-const std::array<int, 12> GAME_PHASE_INCREMENT = {0, 0, 11, 11, 11, 11, 21, 21, 42, 42, 0, 0};
+constexpr std::array<int, 6> MG_PIECE_VALUES = {82, 337, 365, 477, 1025, 0};
+constexpr std::array<int, 6> EG_PIECE_VALUES = {94, 281, 297, 512, 936, 0};
 
-const std::array<std::array<int, 64>, 6> mg_piece_tables = {
+constexpr std::array<std::array<int, 64>, 6> mg_piece_tables = {
   mg_pawn_table,
   mg_knight_table,
   mg_bishop_table,
@@ -151,7 +151,7 @@ const std::array<std::array<int, 64>, 6> mg_piece_tables = {
   mg_king_table
 };
 
-const std::array<std::array<int, 64>, 6> eg_piece_tables = {
+constexpr std::array<std::array<int, 64>, 6> eg_piece_tables = {
   eg_pawn_table,
   eg_knight_table,
   eg_bishop_table,
@@ -160,80 +160,64 @@ const std::array<std::array<int, 64>, 6> eg_piece_tables = {
   eg_king_table
 };
 
-std::array<std::array<int, 64>, 12> init_tables(bool eg) {
-  std::array<std::array<int, 64>, 12> table;
-  uint8_t piece, sq;
-  for (piece = WHITE_PAWN; piece < NO_PIECE; piece+=2) {
+// Constant initialized, so positions built before main can already use it
+constexpr std::array<std::array<Evaluation::Score, 64>, 12> init_psqt() {
+  std::array<std::array<Evaluation::Score, 64>, 12> table = {};
+  for (uint8_t piece = WHITE_PAWN; piece < NO_PIECE; piece += 2) {
     uint8_t piece_type = piece >> 1;
-    for (sq = 0; sq < MoveUtility::NO_SQUARE; sq++) {
-      if (eg) {
-        table[piece][sq] = EG_PIECE_VALUES[piece_type] + eg_piece_tables[piece_type][sq^56];
-        table[piece+1][sq] = EG_PIECE_VALUES[piece_type] + eg_piece_tables[piece_type][sq]; 
-      } else {
-        table[piece][sq] = MG_PIECE_VALUES[piece_type] + mg_piece_tables[piece_type][sq^56]; 
-        table[piece+1][sq] = MG_PIECE_VALUES[piece_type] + mg_piece_tables[piece_type][sq]; 
-      }
+    for (uint8_t sq = 0; sq < 64; sq++) {
+      // The tables above are laid out rank 8 first, as seen by white
+      table[piece][sq] = Evaluation::make_score(MG_PIECE_VALUES[piece_type] + mg_piece_tables[piece_type][sq ^ 56],
+                                                EG_PIECE_VALUES[piece_type] + eg_piece_tables[piece_type][sq ^ 56]);
+      table[piece + 1][sq] = -Evaluation::make_score(MG_PIECE_VALUES[piece_type] + mg_piece_tables[piece_type][sq],
+                                                     EG_PIECE_VALUES[piece_type] + eg_piece_tables[piece_type][sq]);
     }
   }
   return table;
-};
-
-const std::array<std::array<int, 64>, 12> eg_table = init_tables(1);
-const std::array<std::array<int, 64>, 12> mg_table = init_tables(0);
+}
 
 }
 
 namespace Evaluation {
 
-int32_t evaluate_position(const Position& pos) {
-
-  int32_t mg_score = 0;
-  int32_t eg_score = 0;
-  int32_t game_phase = 0;
-
-  // WHITE PIECES
-  for (uint8_t piece = WHITE_PAWN; piece < BLACK_KING; piece+=2) {
-    // array and indexing?
-
-    // Positional Bonuses
-    // WHILE POP
-    uint64_t piece_bb = pos.all_piece_bitboards[piece];
-    while (piece_bb) {
-      
-      uint8_t square = MoveUtility::get_lsbit_index(piece_bb);
-      pop_bit(piece_bb, square);
-
-      mg_score += mg_table[piece][square];
-      eg_score += mg_table[piece][square];
-      game_phase += GAME_PHASE_INCREMENT[piece];
-    } 
+constexpr std::array<std::array<Score, 64>, 12> PSQT = init_psqt();
+constexpr std::array<int32_t, 12> GAME_PHASE_INCREMENT = {0, 0, 11, 11, 11, 11, 21, 21, 42, 42, 0, 0};
 
-  }
+namespace {
 
-  // BLACK PIECES
-  for (uint8_t piece = BLACK_PAWN; piece < NO_PIECE; piece+=2) {
-    // array and indexing?
+// Passed pawn whose stop square is empty, on top of the pawn table's bonus
+constexpr Score FREE_PASSER = make_score(5, 20);
+// Knight on the opponent's side of the board, defended by a pawn and out of reach of enemy pawns
+constexpr Score KNIGHT_OUTPOST = make_score(20, 10);
+// Ranks 4 to 6 from each side's point of view
+constexpr std::array<uint64_t, 2> OUTPOST_RANKS = {MoveUtility::RANK_4 | MoveUtility::RANK_5 | MoveUtility::RANK_6,
+                                                   MoveUtility::RANK_3 | MoveUtility::RANK_4 | MoveUtility::RANK_5};
+
+// Terms that need the cached pawn sets and the other pieces, positive is good for color
+Score evaluate_pieces(const Position& pos, const PawnEntry& pawns, uint8_t color) {
+  uint8_t them = color ^ 1;
+  uint64_t stops = color == WHITE ? pawns.passed[color] << 8 : pawns.passed[color] >> 8;
+  Score score = FREE_PASSER * MoveUtility::count_bits(stops & ~pos.total_bb);
+
+  uint64_t outposts = OUTPOST_RANKS[color] & pawns.attacks[color] & ~pawns.attack_span[them];
+  score += KNIGHT_OUTPOST * MoveUtility::count_bits(pos.all_piece_bitboards[WHITE_KNIGHT + color] & outposts);
+  return score;
+}
 
-    // Positional Bonuses
-    // WHILE POP
-    uint64_t piece_bb = pos.all_piece_bitboards[piece];
-    while (piece_bb) {
-      
-      uint8_t square = MoveUtility::get_lsbit_index(piece_bb);
-      pop_bit(piece_bb, square);
+}
 
-      mg_score -= mg_table[piece][square];
-      eg_score -= eg_table[piece][square];
-      game_phase += GAME_PHASE_INCREMENT[piece];
-    } 
+// Tapered between the middlegame and endgame sums kept by Position and the pawn terms
+int32_t evaluate_position(const Position& pos, PawnTable& pawn_table) {
 
-  }
+  PawnEntry* pawns = pawn_table.probe(pos);
+  Score total = pos.psq_score + pawns->score + pawns->king_shelter(pos, WHITE) - pawns->king_shelter(pos, BLACK) +
+                evaluate_pieces(pos, *pawns, WHITE) - evaluate_pieces(pos, *pawns, BLACK);
 
-  int mg_phase = game_phase;
+  int32_t mg_phase = pos.game_phase;
   if (mg_phase > 256) mg_phase = 256;
-  int eg_phase = 256 - mg_phase;
+  int32_t eg_phase = 256 - mg_phase;
 
-  int32_t score = ((mg_score * mg_phase + eg_score * eg_phase) >> 8);
+  int32_t score = (mg_value(total) * mg_phase + eg_value(total) * eg_phase) >> 8;
 
   if (pos.side_to_move == BLACK) score = -score;
 
@@ -3,8 +3,33 @@
 #include <cstdint>
 #include "position.h"
 
+class PawnTable;
+
 namespace Evaluation {
 
-int32_t evaluate_position(const Position& pos);
+// Middlegame value in the upper 16 bits and endgame value in the lower 16, so a single
+// addition updates both. Position keeps the sum over its pieces up to date move by move.
+using Score = int32_t;
+
+constexpr Score make_score(int32_t mg, int32_t eg) {
+  return (Score)((uint32_t)mg << 16) + eg;
+}
+
+// Adding 0x8000 undoes the borrow a negative endgame value takes from the upper half
+inline int32_t mg_value(Score score) {
+  return (int16_t)((uint32_t)(score + 0x8000) >> 16);
+}
+
+inline int32_t eg_value(Score score) {
+  return (int16_t)(uint16_t)score;
+}
+
+// [piece][square], material plus placement from white's point of view, negative for black pieces
+extern const std::array<std::array<Score, 64>, 12> PSQT;
+// [piece], 256 with every piece of the starting position on the board
+extern const std::array<int32_t, 12> GAME_PHASE_INCREMENT;
+
+// Score for the side to move, pawn structure looked up in the thread's pawn table
+int32_t evaluate_position(const Position& pos, PawnTable& pawn_table);
 
-}
\ No newline at end of file
+}
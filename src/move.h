@@ -38,6 +38,15 @@ struct Move {
   }
 };
 
+// Most moves any position can have is 218
+constexpr int MAX_MOVES = 256;
+
+// A generated move next to its ordering score, so picking the next move reads one array
+struct ScoredMove {
+  Move move;
+  int32_t score;
+};
+
   // FLAGS
   //   0 - NORMAL MOVE
   //   1-4 - PROMOTION
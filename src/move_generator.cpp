@@ -5,36 +5,217 @@
 #include "position.h"
 #include <cstdint>
 #include "search.h"
+#include "see.h"
 
 using namespace MoveUtility;
 
-void MoveGenerator::generate(const Position& pos, const std::array<Move, 2> killers, const PST& hist_heur) {
+namespace {
+
+// Destination squares for pieces other than pawns
+template<uint8_t Us, GenType Type>
+inline uint64_t target_squares(const Position& pos) {
+  if constexpr (Type == CAPTURES) {
+    return pos.occupancy_bitboards[Us ^ 1];
+  } else if constexpr (Type == QUIETS || Type == QUIET_CHECKS) {
+    return ~pos.total_bb;
+  } else {
+    return ~pos.occupancy_bitboards[Us];
+  }
+}
+
+}
+
+void MoveGenerator::generate(const Position& pos, const std::array<Move, 2> killers, const QuietHistory& history,
+                             Move tt_move) {
   count = 0;
+  set_ordering(killers, history, tt_move);
+  append<ALL>(pos);
+}
+
+void MoveGenerator::generate(const Position& pos) {
+  generate(pos, {Move(), Move()}, QuietHistory());
+}
+
+void MoveGenerator::set_ordering(const std::array<Move, 2> killers, const QuietHistory& history, Move tt_move) {
+  hash_move = tt_move;
   ply_killers[0] = killers[0];
   ply_killers[1] = killers[1];
-  history_heuristic = &hist_heur;
+  quiet_history = history;
+}
 
+template<GenType Type>
+void MoveGenerator::append(const Position& pos) {
+  position = &pos;
+  // A generator with its own attack info can't tell whether the position changed since the last call
+  if (attack_info == &own_attack_info) own_attack_info.valid = false;
+  attack_info->update(pos);
   if (pos.side_to_move == WHITE) {
-    generate_all_moves<WHITE>(pos);
+    generate_all_moves<WHITE, Type>(pos);
   } else {
-    generate_all_moves<BLACK>(pos);
+    generate_all_moves<BLACK, Type>(pos);
+  }
+}
+
+template void MoveGenerator::append<CAPTURES>(const Position& pos);
+template void MoveGenerator::append<QUIETS>(const Position& pos);
+template void MoveGenerator::append<QUIET_CHECKS>(const Position& pos);
+template void MoveGenerator::append<EVASIONS>(const Position& pos);
+template void MoveGenerator::append<ALL>(const Position& pos);
+
+void MoveGenerator::update_check_info(const Position& pos) {
+  uint8_t Us = pos.side_to_move;
+  uint8_t Them = Us ^ 1;
+  enemy_king_square = get_lsbit_index(pos.all_piece_bitboards[WHITE_KING + Them]);
+
+  check_squares[PAWN] = PAWN_ATTACKS[Them][enemy_king_square];
+  check_squares[KNIGHT] = KNIGHT_MOVES[enemy_king_square];
+  check_squares[BISHOP] = get_bishop_attacks(enemy_king_square, pos.total_bb);
+  check_squares[ROOK] = get_rook_attacks(enemy_king_square, pos.total_bb);
+  check_squares[QUEEN] = check_squares[BISHOP] | check_squares[ROOK];
+  check_squares[KING] = 0;
+
+  // Same walk as the pin detection, but from the enemy king and with our sliders behind our pieces
+  uint64_t snipers =
+    (get_rook_attacks(enemy_king_square, 0ULL) &
+      (pos.all_piece_bitboards[WHITE_ROOK + Us] | pos.all_piece_bitboards[WHITE_QUEEN + Us])) |
+    (get_bishop_attacks(enemy_king_square, 0ULL) &
+      (pos.all_piece_bitboards[WHITE_BISHOP + Us] | pos.all_piece_bitboards[WHITE_QUEEN + Us]));
+
+  discoverers = 0;
+  while (snipers) {
+    uint8_t sniper_sq = get_lsbit_index(snipers);
+    pop_bit(snipers, sniper_sq);
+    uint64_t blockers = BETWEEN[enemy_king_square][sniper_sq] & pos.total_bb;
+    if (count_bits(blockers) == 1) discoverers |= blockers & pos.occupancy_bitboards[Us];
   }
 }
 
+inline uint64_t MoveGenerator::checking_targets(uint8_t piece, uint8_t from_sq) const {
+  // A discoverer checks from anywhere off the line it is blocking
+  if (discoverers & (1ULL << from_sq)) return check_squares[piece] | ~LINE[enemy_king_square][from_sq];
+  return check_squares[piece];
+}
+
+template<uint8_t Us, GenType Type>
+inline bool MoveGenerator::reaches_targets(const Position& pos, uint8_t piece) const {
+  return (attack_info->by_piece[Us][piece] & target_squares<Us, Type>(pos) & attack_info->check_mask) != 0;
+}
+
+inline bool MoveGenerator::pin_allows(uint8_t from_sq, uint8_t to_sq) const {
+  return !(attack_info->pinned & (1ULL << from_sq)) || (LINE[attack_info->king_square][from_sq] & (1ULL << to_sq));
+}
+
+bool MoveGenerator::is_legal(const Position& pos, Move move, const AttackInfo& info) {
+  uint8_t Us = pos.side_to_move;
+  uint8_t Them = Us ^ 1;
+  uint8_t from_sq = move.get_from_sq();
+  uint8_t to_sq = move.get_to_sq();
+  uint8_t flags = move.get_flags();
+  uint64_t to_bit = 1ULL << to_sq;
+
+  // is_pseudo_legal already checked the castling path
+  if (flags == CASTLE_KINGSIDE || flags == CASTLE_QUEENSIDE) return true;
+
+  if ((pos.piece_list[from_sq] >> 1) == KING) return !(info.king_danger & to_bit);
+
+  // En passant takes two pieces off the capturing pawn's rank, only a full test catches that pin
+  if (flags == EN_PASSANT) {
+    uint64_t captured = 1ULL << ((Us == WHITE) ? to_sq - 8 : to_sq + 8);
+    uint64_t occupancy = ((pos.total_bb ^ (1ULL << from_sq)) & ~captured) | to_bit;
+    return !(attackers_to(pos, info.king_square, occupancy) & pos.occupancy_bitboards[Them] & ~captured);
+  }
+
+  if (count_bits(info.checkers) > 1 || !(info.check_mask & to_bit)) return false;
+  return !(info.pinned & (1ULL << from_sq)) || (LINE[info.king_square][from_sq] & to_bit);
+}
+
+bool MoveGenerator::is_pseudo_legal(const Position& pos, Move move, const AttackInfo& info) {
+  if (move.move_data == 0) return false;
+
+  uint8_t Us = pos.side_to_move;
+  uint8_t from_sq = move.get_from_sq();
+  uint8_t to_sq = move.get_to_sq();
+  uint8_t flags = move.get_flags();
+  uint8_t moving_piece_type = pos.piece_list[from_sq];
+  uint64_t to_bit = 1ULL << to_sq;
+
+  if (moving_piece_type == NO_PIECE || (moving_piece_type & 1) != Us) return false;
+  if (pos.occupancy_bitboards[Us] & to_bit) return false;
+
+  uint8_t piece = moving_piece_type >> 1;
+
+  if (flags == CASTLE_KINGSIDE || flags == CASTLE_QUEENSIDE) {
+    uint8_t king_square = (Us == WHITE) ? 4U : 60U;
+    if (piece != KING || from_sq != king_square) return false;
+
+    bool kingside = flags == CASTLE_KINGSIDE;
+    uint8_t right = kingside ? (1U << (2 * Us)) : (2U << (2 * Us));
+    uint64_t path_mask = kingside ? (0x60ULL << (56 * Us)) : (0xEULL << (56 * Us));
+    if (to_sq != (kingside ? king_square + 2 : king_square - 2)) return false;
+    if (!(pos.castling_rights & right) || (pos.total_bb & path_mask)) return false;
+
+    // King may not start in, pass through or land on an attacked square
+    uint64_t king_path = kingside ? (0x70ULL << (56 * Us)) : (0x1CULL << (56 * Us));
+    return !(info.by_side[Us ^ 1] & king_path);
+  }
+
+  if (piece == PAWN) {
+    uint64_t promotion_rank = (Us == WHITE) ? RANK_8 : RANK_1;
+    bool is_promotion = flags >= PROMO_KNIGHT && flags <= PROMO_QUEEN;
+
+    if (flags == EN_PASSANT) {
+      return to_sq == pos.en_passant_sq && (PAWN_ATTACKS[Us][from_sq] & to_bit);
+    }
+    if (flags != NORMAL_MOVE && !is_promotion) return false;
+    if (is_promotion != ((to_bit & promotion_rank) != 0)) return false;
+
+    if (PAWN_ATTACKS[Us][from_sq] & to_bit) return (pos.occupancy_bitboards[Us ^ 1] & to_bit) != 0;
+
+    int forward = (Us == WHITE) ? 8 : -8;
+    if (to_sq == from_sq + forward) return !(pos.total_bb & to_bit);
+
+    uint8_t start_rank = (Us == WHITE) ? 1 : 6;
+    if (to_sq == from_sq + 2 * forward && from_sq / 8 == start_rank) {
+      uint64_t path = to_bit | (1ULL << (from_sq + forward));
+      return !(pos.total_bb & path);
+    }
+    return false;
+  }
+
+  if (flags != NORMAL_MOVE) return false;
+
+  uint64_t attacks = 0;
+  if (piece == KNIGHT) attacks = KNIGHT_MOVES[from_sq];
+  if (piece == BISHOP) attacks = get_bishop_attacks(from_sq, pos.total_bb);
+  if (piece == ROOK) attacks = get_rook_attacks(from_sq, pos.total_bb);
+  if (piece == QUEEN) attacks = get_bishop_attacks(from_sq, pos.total_bb) | get_rook_attacks(from_sq, pos.total_bb);
+  if (piece == KING) attacks = KING_MOVES[from_sq];
+
+  return (attacks & to_bit) != 0;
+}
+
 inline void MoveGenerator::add_move(Move move, uint8_t moving_piece_type, uint8_t captured_piece_type) {
 
-  move_list[count] = move;
+  moves[count].move = move;
   uint8_t flags = move.get_flags();
 
+  // Best move stored in the transposition table is searched first
+  if (move == hash_move) {
+    moves[count].score = HASH_MOVE_BAND;
+    count++;
+    return;
+  }
+
+  // Promotions, by capture or not, are scored here and never reach the capture scoring below
   if (flags >= PROMO_KNIGHT && flags <= PROMO_QUEEN) {
     if (flags == PROMO_QUEEN) {
-      score_list[count] = QUEEN_PROMO_BONUS;
+      moves[count].score = QUEEN_PROMO_BONUS;
     } else {
-      score_list[count] = WINNING_CAPTURE - 500'000;
+      moves[count].score = WINNING_CAPTURE - 500'000;
     }
     if (captured_piece_type != NO_PIECE) {
       uint8_t victim_rank = PIECE_RANKS[captured_piece_type];
-      score_list[count] += (10 * victim_rank);
+      moves[count].score += (10 * victim_rank);
     }
     count++;
     return;
@@ -46,32 +227,40 @@ inline void MoveGenerator::add_move(Move move, uint8_t moving_piece_type, uint8_
 
     int32_t mvv_lva_score = 10*(victim_rank) - attacker_rank;
 
-    if (move.get_flags() == PROMO_QUEEN) {
-      score_list[count] = QUEEN_PROMO_BONUS + mvv_lva_score;
-      count++;
-      return;
-    }
-
     if (victim_rank > attacker_rank) {
-      score_list[count] = WINNING_CAPTURE + mvv_lva_score;
-    } else if (victim_rank == attacker_rank) {
-      score_list[count] = EQUAL_CAPTURE + mvv_lva_score;
+      // Taking a more valuable piece wins material whatever the recaptures
+      moves[count].score = WINNING_CAPTURE + mvv_lva_score;
     } else {
-      score_list[count] = LOSING_CAPTURE + mvv_lva_score;
+      int32_t see_score = SEE::evaluate(*position, move);
+      if (see_score > 0) {
+        moves[count].score = WINNING_CAPTURE + mvv_lva_score;
+      } else if (see_score == 0) {
+        moves[count].score = EQUAL_CAPTURE + mvv_lva_score;
+      } else {
+        moves[count].score = LOSING_CAPTURE + mvv_lva_score;
+      }
     }
   } else {
     // QUIET MOVE
     // Killer move
 
     if (move == ply_killers[0]) {
-      score_list[count] = KILLER_1_BAND;
+      moves[count].score = KILLER_1_BAND;
     } else if (move == ply_killers[1]) {
-      score_list[count] = KILLER_2_BAND;
+      moves[count].score = KILLER_2_BAND;
+    } else if (move == quiet_history.counter_move) {
+      moves[count].score = COUNTER_MOVE_BAND;
     } else if (flags == CASTLE_KINGSIDE || flags == CASTLE_QUEENSIDE) {
-      score_list[count] = CASTLE_BONUS;
+      moves[count].score = CASTLE_BONUS;
     } else {
-      // History Heuristic
-      score_list[count] = (*history_heuristic)[moving_piece_type][move.get_to_sq()];
+      // Butterfly history plus the continuation histories of the last two moves
+      uint8_t to_sq = move.get_to_sq();
+      int32_t score = 0;
+      if (quiet_history.butterfly) score = (*quiet_history.butterfly)[moving_piece_type & 1][move.get_from_sq()][to_sq];
+      for (const PieceToHistory* table : quiet_history.continuation) {
+        if (table) score += (*table)[moving_piece_type][to_sq];
+      }
+      moves[count].score = score;
     }
 
   }
@@ -80,6 +269,10 @@ inline void MoveGenerator::add_move(Move move, uint8_t moving_piece_type, uint8_
 }
 
 bool MoveGenerator::is_square_attacked(const Position& pos, uint8_t square, uint8_t Us) {
+  return is_square_attacked(pos, square, Us, pos.total_bb);
+}
+
+bool MoveGenerator::is_square_attacked(const Position& pos, uint8_t square, uint8_t Us, uint64_t occupancy) {
   uint8_t Them = (Us == WHITE) ? BLACK : WHITE;
 
   // Pawn attack
@@ -91,33 +284,57 @@ bool MoveGenerator::is_square_attacked(const Position& pos, uint8_t square, uint
   // King attack
   if (KING_MOVES[square] & pos.all_piece_bitboards[WHITE_KING + Them]) return true;
 
-  if (get_rook_attacks(square, pos.total_bb) &
+  if (get_rook_attacks(square, occupancy) &
     (pos.all_piece_bitboards[WHITE_ROOK + Them] | pos.all_piece_bitboards[WHITE_QUEEN + Them])) return true;
 
-  if (get_bishop_attacks(square, pos.total_bb) &
+  if (get_bishop_attacks(square, occupancy) &
     (pos.all_piece_bitboards[WHITE_BISHOP + Them] | pos.all_piece_bitboards[WHITE_QUEEN + Them])) return true;
 
   return false;
 }
 
-template<uint8_t Us>
+uint64_t MoveGenerator::attackers_to(const Position& pos, uint8_t square, uint64_t occupancy) {
+  uint64_t rooks = pos.all_piece_bitboards[WHITE_ROOK] | pos.all_piece_bitboards[BLACK_ROOK] |
+                   pos.all_piece_bitboards[WHITE_QUEEN] | pos.all_piece_bitboards[BLACK_QUEEN];
+  uint64_t bishops = pos.all_piece_bitboards[WHITE_BISHOP] | pos.all_piece_bitboards[BLACK_BISHOP] |
+                     pos.all_piece_bitboards[WHITE_QUEEN] | pos.all_piece_bitboards[BLACK_QUEEN];
+
+  return (PAWN_ATTACKS[BLACK][square] & pos.all_piece_bitboards[WHITE_PAWN]) |
+         (PAWN_ATTACKS[WHITE][square] & pos.all_piece_bitboards[BLACK_PAWN]) |
+         (KNIGHT_MOVES[square] & (pos.all_piece_bitboards[WHITE_KNIGHT] | pos.all_piece_bitboards[BLACK_KNIGHT])) |
+         (KING_MOVES[square] & (pos.all_piece_bitboards[WHITE_KING] | pos.all_piece_bitboards[BLACK_KING])) |
+         (get_rook_attacks(square, occupancy) & rooks) |
+         (get_bishop_attacks(square, occupancy) & bishops);
+}
+
+template<uint8_t Us, GenType Type>
 void MoveGenerator::generate_all_moves(const Position& pos) {
-  generate_pawn_moves<Us>(pos);
-  generate_knight_moves<Us>(pos);
-  generate_bishop_moves<Us>(pos);
-  generate_rook_moves<Us>(pos);
-  generate_queen_moves<Us>(pos);
-  generate_king_moves<Us>(pos);
+  // Double check, only a king move can help
+  if (count_bits(attack_info->checkers) > 1) {
+    if constexpr (Type != QUIET_CHECKS) generate_king_moves<Us, Type>(pos);
+    return;
+  }
+
+  if constexpr (Type == QUIET_CHECKS) update_check_info(pos);
+
+  generate_pawn_moves<Us, Type>(pos);
+  generate_knight_moves<Us, Type>(pos);
+  generate_bishop_moves<Us, Type>(pos);
+  generate_rook_moves<Us, Type>(pos);
+  generate_queen_moves<Us, Type>(pos);
+  generate_king_moves<Us, Type>(pos);
 }
 
 // "Us" is the side to move
-template<uint8_t Us>
+template<uint8_t Us, GenType Type>
 void MoveGenerator::generate_knight_moves(const Position& pos) {
 
   constexpr uint8_t Them = (Us == WHITE) ? BLACK : WHITE;
   constexpr uint8_t moving_piece_type = (Us == WHITE) ? WHITE_KNIGHT : BLACK_KNIGHT;
   // Find knight bb
-  uint64_t temp_knight_bb = pos.all_piece_bitboards[WHITE_KNIGHT + Us];
+  // A attack_info->pinned knight can never move
+  uint64_t temp_knight_bb = pos.all_piece_bitboards[WHITE_KNIGHT + Us] & ~attack_info->pinned;
+  if (!reaches_targets<Us, Type>(pos, KNIGHT)) return;
 
   // While-pop iteration
   while(temp_knight_bb) {
@@ -127,7 +344,8 @@ void MoveGenerator::generate_knight_moves(const Position& pos) {
     uint64_t attacks = KNIGHT_MOVES[from_sq];
 
     // Filter moves where the destination square contains a friendly piece
-    attacks &= ~pos.occupancy_bitboards[WHITE + Us];
+    attacks &= target_squares<Us, Type>(pos) & attack_info->check_mask;
+    if constexpr (Type == QUIET_CHECKS) attacks &= checking_targets(KNIGHT, from_sq);
 
     while (attacks) {
       uint8_t to_sq = get_lsbit_index(attacks);
@@ -139,19 +357,22 @@ void MoveGenerator::generate_knight_moves(const Position& pos) {
   }
 }
 
-template<uint8_t Us>
+template<uint8_t Us, GenType Type>
 void MoveGenerator::generate_bishop_moves(const Position& pos) {
 
   constexpr uint8_t Them = (Us == WHITE) ? BLACK : WHITE;
   constexpr uint8_t moving_piece_type = (Us == WHITE) ? WHITE_BISHOP : BLACK_BISHOP;
   uint64_t temp_bishop_bb = pos.all_piece_bitboards[WHITE_BISHOP + Us];
+  if (!reaches_targets<Us, Type>(pos, BISHOP)) return;
 
   while (temp_bishop_bb) {
 
     uint8_t from_sq = get_lsbit_index(temp_bishop_bb);
     pop_bit(temp_bishop_bb, from_sq);
     uint64_t attacks = get_bishop_attacks(from_sq, pos.total_bb);
-    attacks &= ~pos.occupancy_bitboards[WHITE + Us];
+    attacks &= target_squares<Us, Type>(pos) & attack_info->check_mask;
+    if (attack_info->pinned & (1ULL << from_sq)) attacks &= LINE[attack_info->king_square][from_sq];
+    if constexpr (Type == QUIET_CHECKS) attacks &= checking_targets(BISHOP, from_sq);
 
     while (attacks) {
 
@@ -164,19 +385,22 @@ void MoveGenerator::generate_bishop_moves(const Position& pos) {
   }
 }
 
-template<uint8_t Us>
+template<uint8_t Us, GenType Type>
 void MoveGenerator::generate_rook_moves(const Position& pos) {
 
   constexpr uint8_t Them = (Us == WHITE) ? BLACK : WHITE;
   constexpr uint8_t moving_piece_type = (Us == WHITE) ? WHITE_ROOK : BLACK_ROOK;
   uint64_t temp_rook_bb = pos.all_piece_bitboards[WHITE_ROOK + Us];
+  if (!reaches_targets<Us, Type>(pos, ROOK)) return;
 
   while (temp_rook_bb) {
 
     uint8_t from_sq = get_lsbit_index(temp_rook_bb);
     pop_bit(temp_rook_bb, from_sq);
     uint64_t attacks = get_rook_attacks(from_sq, pos.total_bb);
-    attacks &= ~pos.occupancy_bitboards[WHITE + Us];
+    attacks &= target_squares<Us, Type>(pos) & attack_info->check_mask;
+    if (attack_info->pinned & (1ULL << from_sq)) attacks &= LINE[attack_info->king_square][from_sq];
+    if constexpr (Type == QUIET_CHECKS) attacks &= checking_targets(ROOK, from_sq);
 
     while (attacks) {
 
@@ -189,12 +413,13 @@ void MoveGenerator::generate_rook_moves(const Position& pos) {
   }
 }
 
-template<uint8_t Us>
+template<uint8_t Us, GenType Type>
 void MoveGenerator::generate_queen_moves(const Position& pos) {
 
   constexpr uint8_t Them = (Us == WHITE) ? BLACK : WHITE;
   constexpr uint8_t moving_piece_type = (Us == WHITE) ? WHITE_QUEEN : BLACK_QUEEN;
   uint64_t temp_queen_bb = pos.all_piece_bitboards[WHITE_QUEEN + Us];
+  if (!reaches_targets<Us, Type>(pos, QUEEN)) return;
 
   while (temp_queen_bb) {
 
@@ -202,7 +427,9 @@ void MoveGenerator::generate_queen_moves(const Position& pos) {
     pop_bit(temp_queen_bb, from_sq);
     uint64_t attacks = get_rook_attacks(from_sq, pos.total_bb) |
                         get_bishop_attacks(from_sq, pos.total_bb);
-    attacks &= ~pos.occupancy_bitboards[WHITE + Us];
+    attacks &= target_squares<Us, Type>(pos) & attack_info->check_mask;
+    if (attack_info->pinned & (1ULL << from_sq)) attacks &= LINE[attack_info->king_square][from_sq];
+    if constexpr (Type == QUIET_CHECKS) attacks &= checking_targets(QUEEN, from_sq);
     while (attacks) {
       uint8_t to_sq = get_lsbit_index(attacks);
       pop_bit(attacks, to_sq);
@@ -213,76 +440,55 @@ void MoveGenerator::generate_queen_moves(const Position& pos) {
   }
 }
 
-template<uint8_t Us>
+template<uint8_t Us, GenType Type>
 void MoveGenerator::generate_king_moves(const Position& pos) {
 
   constexpr uint8_t Them = (Us == WHITE) ? BLACK : WHITE;
   constexpr uint8_t moving_piece_type = (Us == WHITE) ? WHITE_KING : BLACK_KING;
-  uint64_t temp_king_bb = pos.all_piece_bitboards[WHITE_KING + Us];
-
-  while (temp_king_bb) {
+  uint8_t from_sq = attack_info->king_square;
+  uint64_t attacks = KING_MOVES[from_sq];
+  attacks &= target_squares<Us, Type>(pos);
+  if constexpr (Type == QUIET_CHECKS) attacks &= checking_targets(KING, from_sq);
 
-    uint8_t from_sq = get_lsbit_index(temp_king_bb);
-    pop_bit(temp_king_bb, from_sq);
-    uint64_t attacks = KING_MOVES[from_sq];
-    attacks &= ~pos.occupancy_bitboards[WHITE + Us];
+  attacks &= ~attack_info->king_danger;
 
-    while (attacks) {
+  while (attacks) {
 
-      uint8_t to_sq = get_lsbit_index(attacks);
-      pop_bit(attacks, to_sq);
-      uint8_t to_piece_type = pos.piece_list[to_sq];
-      Move move(from_sq, to_sq);
-      add_move(move, moving_piece_type, to_piece_type);
-    }
+    uint8_t to_sq = get_lsbit_index(attacks);
+    pop_bit(attacks, to_sq);
+    uint8_t to_piece_type = pos.piece_list[to_sq];
+    Move move(from_sq, to_sq);
+    add_move(move, moving_piece_type, to_piece_type);
   }
 
+  if constexpr (Type == CAPTURES || Type == QUIET_CHECKS || Type == EVASIONS) return;
+
+  // No castling out of check
+  if (attack_info->checkers) return;
+
   // Kingside Castle
   const uint8_t kingside_castle = (Us == WHITE) ? pos.castling_rights & 1U : pos.castling_rights & 4U;
   const uint8_t queenside_castle = (Us == WHITE) ? pos.castling_rights & 2U : pos.castling_rights & 8U;
   constexpr uint64_t kingside_mask = (Us == WHITE) ? 0x60ULL : 0x60'00'00'00'00'00'00'00ULL;
   constexpr uint64_t queenside_mask = (Us == WHITE) ? 0xEULL : 0x0E'00'00'00'00'00'00'00ULL;
-  constexpr uint8_t king_square = (Us == WHITE) ? 4U : 60U;
-  bool fail;
-
-  if (kingside_castle && !(pos.total_bb & kingside_mask)) {
-    fail = false;
-    for (uint8_t square = king_square; square < (king_square + 3); square++) {
-      if (is_square_attacked(pos, square, Us)) {
-        fail = true;
-        break;
-      }
-    }
+  // Squares the king passes through and lands on, the b file square only has to be empty
+  constexpr uint64_t queenside_path = (Us == WHITE) ? 0xCULL : 0x0C'00'00'00'00'00'00'00ULL;
+  uint64_t attacked = attack_info->by_side[Them];
 
-    if (!fail) {
-      uint8_t from_sq = king_square;
-      uint8_t to_sq = king_square + 2;
-      Move move(from_sq, to_sq, CASTLE_KINGSIDE);
-      add_move(move, moving_piece_type, NO_PIECE);
-    }
+  if (kingside_castle && !(pos.total_bb & kingside_mask) && !(attacked & kingside_mask)) {
+    Move move(attack_info->king_square, attack_info->king_square + 2, CASTLE_KINGSIDE);
+    add_move(move, moving_piece_type, NO_PIECE);
   }
 
   // Queenside Castle
-  if (queenside_castle && !(pos.total_bb & queenside_mask)) {
-    fail = false;
-    for (uint8_t square = king_square; square > king_square - 3; square--) {
-      if (is_square_attacked(pos, square, Us)) {
-        fail = true;
-        break;
-      }
-    }
-
-    if (!fail) {
-      uint8_t from_sq = king_square;
-      uint8_t to_sq = king_square - 2;
-      Move move(from_sq, to_sq, CASTLE_QUEENSIDE);
-      add_move(move, moving_piece_type, NO_PIECE);
-    }
+  if (queenside_castle && !(pos.total_bb & queenside_mask) && !(attacked & queenside_path)) {
+    Move move(attack_info->king_square, attack_info->king_square - 2, CASTLE_QUEENSIDE);
+    add_move(move, moving_piece_type, NO_PIECE);
   }
 
 }
 
-template<uint8_t Us>
+template<uint8_t Us, GenType Type>
 void MoveGenerator::generate_pawn_moves(const Position& pos) {
 
   constexpr uint8_t Them = (Us == WHITE) ? BLACK : WHITE;
@@ -303,24 +509,36 @@ void MoveGenerator::generate_pawn_moves(const Position& pos) {
   }
 
   single_pushes &= ~pos.total_bb;
-  uint64_t push_loop = single_pushes;
+  uint64_t push_loop = single_pushes & attack_info->check_mask;
+
+  // Only queen promotions among the pushes count as captures
+  if constexpr (Type == CAPTURES) push_loop &= PromotionRank;
+  if constexpr (Type == QUIET_CHECKS) push_loop &= ~PromotionRank;
 
   while(push_loop) {
     uint8_t to_sq = get_lsbit_index(push_loop);
     pop_bit(push_loop, to_sq);
     uint8_t from_sq = to_sq - shift;
+    if (!pin_allows(from_sq, to_sq)) continue;
+    if constexpr (Type == QUIET_CHECKS) {
+      if (!(checking_targets(PAWN, from_sq) & (1ULL << to_sq))) continue;
+    }
 
     // Check promotion
     if (1ULL << to_sq & PromotionRank) {
-      Move queen_promo(from_sq, to_sq,PROMO_QUEEN);
-      Move knight_promo(from_sq, to_sq,PROMO_KNIGHT);
-      Move rook_promo(from_sq, to_sq,PROMO_ROOK);
-      Move bishop_promo(from_sq, to_sq,PROMO_BISHOP);
-
-      add_move(queen_promo, moving_piece_type, NO_PIECE);
-      add_move(knight_promo, moving_piece_type, NO_PIECE);
-      add_move(rook_promo, moving_piece_type, NO_PIECE);
-      add_move(bishop_promo, moving_piece_type, NO_PIECE);
+      if constexpr (Type != QUIETS) {
+        Move queen_promo(from_sq, to_sq,PROMO_QUEEN);
+        add_move(queen_promo, moving_piece_type, NO_PIECE);
+      }
+      if constexpr (Type != CAPTURES) {
+        Move knight_promo(from_sq, to_sq,PROMO_KNIGHT);
+        Move rook_promo(from_sq, to_sq,PROMO_ROOK);
+        Move bishop_promo(from_sq, to_sq,PROMO_BISHOP);
+
+        add_move(knight_promo, moving_piece_type, NO_PIECE);
+        add_move(rook_promo, moving_piece_type, NO_PIECE);
+        add_move(bishop_promo, moving_piece_type, NO_PIECE);
+      }
     } else {
       Move move(from_sq, to_sq);
       add_move(move, moving_piece_type, NO_PIECE);
@@ -328,35 +546,44 @@ void MoveGenerator::generate_pawn_moves(const Position& pos) {
   }
 
   // Double Push
-  uint64_t double_pushes = 0ULL;
+  if constexpr (Type != CAPTURES) {
+    uint64_t double_pushes = 0ULL;
 
-  if constexpr (Us == WHITE) {
-    double_pushes = single_pushes << 8;
-  } else {
-    double_pushes = single_pushes >> 8;
-  }
+    if constexpr (Us == WHITE) {
+      double_pushes = single_pushes << 8;
+    } else {
+      double_pushes = single_pushes >> 8;
+    }
 
-  double_pushes &= DoublePushRank;
-  double_pushes &= ~pos.total_bb;
+    double_pushes &= DoublePushRank;
+    double_pushes &= ~pos.total_bb & attack_info->check_mask;
 
-  while(double_pushes) {
-    uint8_t to_sq = get_lsbit_index(double_pushes);
-    pop_bit(double_pushes, to_sq);
-    uint8_t from_sq = to_sq - shift*2;
+    while(double_pushes) {
+      uint8_t to_sq = get_lsbit_index(double_pushes);
+      pop_bit(double_pushes, to_sq);
+      uint8_t from_sq = to_sq - shift*2;
+      if (!pin_allows(from_sq, to_sq)) continue;
+      if constexpr (Type == QUIET_CHECKS) {
+        if (!(checking_targets(PAWN, from_sq) & (1ULL << to_sq))) continue;
+      }
 
-    Move move(from_sq, to_sq);
-    add_move(move, moving_piece_type, NO_PIECE);
+      Move move(from_sq, to_sq);
+      add_move(move, moving_piece_type, NO_PIECE);
+    }
   }
 
+  if constexpr (Type == QUIETS || Type == QUIET_CHECKS) return;
+
   // Capture
   uint64_t capture_right = (Us == WHITE) ? ((pawns & ~FILE_H) << 9) :
                                             ((pawns & ~FILE_A) >> 9);
-  capture_right &= enemies;
+  capture_right &= enemies & attack_info->check_mask;
 
   while (capture_right) {
     uint8_t to_sq = get_lsbit_index(capture_right);
     pop_bit(capture_right, to_sq);
     uint8_t from_sq = (Us == WHITE) ? (to_sq - 9) : (to_sq + 9);
+    if (!pin_allows(from_sq, to_sq)) continue;
     uint8_t to_piece_type = pos.piece_list[to_sq];
 
     // Check promotion
@@ -378,13 +605,14 @@ void MoveGenerator::generate_pawn_moves(const Position& pos) {
 
   uint64_t capture_left = (Us == WHITE) ? ((pawns & ~FILE_A) << 7) :
                                             ((pawns & ~FILE_H) >> 7);
-  capture_left &= enemies;
+  capture_left &= enemies & attack_info->check_mask;
 
   while (capture_left) {
     uint8_t to_sq = get_lsbit_index(capture_left);
     uint8_t to_piece_type = pos.piece_list[to_sq];
     pop_bit(capture_left, to_sq);
     uint8_t from_sq = (Us == WHITE) ? (to_sq - 7) : (to_sq + 7);
+    if (!pin_allows(from_sq, to_sq)) continue;
 
     // Check promotion
     if (1ULL << to_sq & PromotionRank) {
@@ -405,12 +633,27 @@ void MoveGenerator::generate_pawn_moves(const Position& pos) {
 
   // En Passant
   if (pos.en_passant_sq != NO_SQUARE) {
+    uint8_t captured_sq = pos.en_passant_sq - shift;
     uint64_t ep_capturing = PAWN_ATTACKS[Them][pos.en_passant_sq];
     ep_capturing &= pawns;
 
+    // Only helps in check by capturing the checking pawn or blocking on the ep square
+    if (!(attack_info->check_mask & ((1ULL << pos.en_passant_sq) | (1ULL << captured_sq)))) ep_capturing = 0;
+
+    uint64_t enemy_rooks = pos.all_piece_bitboards[WHITE_ROOK + Them] | pos.all_piece_bitboards[WHITE_QUEEN + Them];
+    uint64_t enemy_bishops = pos.all_piece_bitboards[WHITE_BISHOP + Them] | pos.all_piece_bitboards[WHITE_QUEEN + Them];
+
     while (ep_capturing) {
       uint8_t from_sq = get_lsbit_index(ep_capturing);
       pop_bit(ep_capturing, from_sq);
+
+      // Both pawns leave their squares at once, which can open a line to our king
+      // that the pin mask does not see (e.g. both on the king's rank)
+      uint64_t occupancy = (pos.total_bb ^ (1ULL << from_sq) ^ (1ULL << captured_sq)) |
+                           (1ULL << pos.en_passant_sq);
+      if ((get_rook_attacks(attack_info->king_square, occupancy) & enemy_rooks) ||
+          (get_bishop_attacks(attack_info->king_square, occupancy) & enemy_bishops)) continue;
+
       Move move(from_sq, pos.en_passant_sq, EN_PASSANT);
       add_move(move, moving_piece_type, WHITE_PAWN);
     }
@@ -2,56 +2,140 @@
 #include "piece.h"
 #include "position.h"
 #include <cstdint>
+#include "attack_info.h"
 #include "search.h"
 #include "move.h"
 
+// Which moves to generate: captures include all promotions by capture and queen promotions by push,
+// quiets are everything else. Quiet checks are the non-promoting quiets that give check, direct or
+// discovered, castling excluded. Evasions are every move when in check.
+enum GenType : uint8_t {
+  CAPTURES,
+  QUIETS,
+  QUIET_CHECKS,
+  EVASIONS,
+  ALL
+};
+
 class MoveGenerator {
 
 public:
 
-  std::array<Move, 256> move_list;
-  std::array<int32_t, 256> score_list;
+  // Not owned, the search hands every node a slice of its SearchStack
+  ScoredMove* moves;
   std::array<Move, 2> ply_killers;
-  const PST* history_heuristic;
+  Move hash_move;
+  QuietHistory quiet_history;
+  // Position being generated for, add_move needs it for SEE
+  const Position* position = nullptr;
+  static const int32_t HASH_MOVE_BAND = 8'000'000;
   static const int32_t WINNING_CAPTURE = 6'000'000;
   static const int32_t EQUAL_CAPTURE = 5'000'000;
   static const int32_t KILLER_1_BAND = 4'000'000;
   static const int32_t KILLER_2_BAND = 3'000'000;
+  static const int32_t COUNTER_MOVE_BAND = 2'000'000;
   static const int32_t LOSING_CAPTURE = -1'000'000;
   static const int32_t CASTLE_BONUS = 10'000;
   static const int32_t QUEEN_PROMO_BONUS = 7'000'000;
   int count;
 
-  MoveGenerator() : count(0) {}
+  // Attack maps and legality info of the position, the search shares them with the rest of
+  // the node. Brought up to date by every generate/append call.
+  AttackInfo* attack_info;
+
+  // QUIET_CHECKS only: squares each piece type checks the enemy king from,
+  // and our pieces whose move uncovers a check from one of our sliders
+  std::array<uint64_t, 6> check_squares;
+  uint64_t discoverers;
+  uint8_t enemy_king_square;
+
+  // buffer must hold MAX_MOVES entries. Without attack_info the generator recomputes its own on every call.
+  explicit MoveGenerator(ScoredMove* buffer, AttackInfo* attack_info = nullptr)
+    : moves(buffer), count(0), attack_info(attack_info ? attack_info : &own_attack_info) {}
+  MoveGenerator(const MoveGenerator&) = delete;
+  MoveGenerator& operator=(const MoveGenerator&) = delete;
+
+  // Every generated move is legal, no make/unmake test is needed afterwards
+  void generate(const Position& pos, const std::array<Move, 2> killers, const QuietHistory& history,
+                Move tt_move = Move());
+
+  // Legal moves without ordering context, for perft and move parsing
+  void generate(const Position& pos);
+
+  // Context used by add_move to score the moves that follow
+  void set_ordering(const std::array<Move, 2> killers, const QuietHistory& history, Move tt_move = Move());
 
-  void generate(const Position& pos, const std::array<Move, 2> killers, const PST& hist_heur);
-  bool is_square_attacked(const Position& pos, uint8_t square, uint8_t Us);
+  // Adds moves of one type after the ones already in moves
+  template<GenType Type>
+  void append(const Position& pos);
+
+  static bool is_square_attacked(const Position& pos, uint8_t square, uint8_t Us);
+  static bool is_square_attacked(const Position& pos, uint8_t square, uint8_t Us, uint64_t occupancy);
+
+  // Pieces of both colors attacking square given the occupancy
+  static uint64_t attackers_to(const Position& pos, uint8_t square, uint64_t occupancy);
+
+  // Whether move could have been generated in pos, for hash moves and killers that come from other positions
+  static bool is_pseudo_legal(const Position& pos, Move move, const AttackInfo& info);
+
+  // Whether a pseudo-legal move leaves our king safe
+  static bool is_legal(const Position& pos, Move move, const AttackInfo& info);
 
 private:
 
+  AttackInfo own_attack_info;
+
   static constexpr std::array<uint8_t, 12> PIECE_RANKS = {1, 1, 2, 2, 2, 2, 3, 3, 4, 4, 5, 5};
 
-  template<uint8_t Us>
+  // Whether our pieces of this type attack any square they could move to, most capture
+  // generation finds nothing to do for a piece type with a single AND
+  template<uint8_t Us, GenType Type>
+  inline bool reaches_targets(const Position& pos, uint8_t piece) const;
+
+  // A pinned piece may only move along the line through it and our king
+  inline bool pin_allows(uint8_t from_sq, uint8_t to_sq) const;
+
+  void update_check_info(const Position& pos);
+
+  // QUIET_CHECKS only: destinations from which a piece of this type on from_sq gives check
+  inline uint64_t checking_targets(uint8_t piece, uint8_t from_sq) const;
+
+  template<uint8_t Us, GenType Type>
   void generate_all_moves(const Position& pos);
 
-  template<uint8_t Us>
+  template<uint8_t Us, GenType Type>
   void generate_knight_moves(const Position& pos);
 
-  template<uint8_t Us>
+  template<uint8_t Us, GenType Type>
   void generate_bishop_moves(const Position& pos);
 
-  template<uint8_t Us>
+  template<uint8_t Us, GenType Type>
   void generate_rook_moves(const Position& pos);
 
-  template<uint8_t Us>
+  template<uint8_t Us, GenType Type>
   void generate_queen_moves(const Position& pos);
 
-  template<uint8_t Us>
+  template<uint8_t Us, GenType Type>
   void generate_king_moves(const Position& pos);
 
-  template<uint8_t Us>
+  template<uint8_t Us, GenType Type>
   void generate_pawn_moves(const Position& pos);
 
   inline void add_move(Move move, uint8_t moving_piece_type, uint8_t captured_piece_type);
 
 };
+
+// Generator with its own buffer, for perft, move parsing and other code outside the search
+class MoveList : public MoveGenerator {
+
+public:
+
+  MoveList() : MoveGenerator(nullptr) { moves = buffer.data(); }
+  MoveList(const MoveList&) = delete;
+  MoveList& operator=(const MoveList&) = delete;
+
+private:
+
+  std::array<ScoredMove, MAX_MOVES> buffer;
+
+};
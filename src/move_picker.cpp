@@ -0,0 +1,120 @@
+#include "move_picker.h"
+#include <array>
+#include <cstdint>
+#include <utility>
+#include "move.h"
+#include "move_generator.h"
+#include "piece.h"
+#include "position.h"
+
+MovePicker::MovePicker(const Position& pos, Move tt_move, const std::array<Move, 2>& killers, const QuietHistory& history,
+                       ScoredMove* buffer, AttackInfo& attack_info)
+  : pos(pos), attack_info(attack_info), move_gen(buffer, &attack_info), tt_move(tt_move), killers(killers), quiet_history(history) {}
+
+Move MovePicker::next_move() {
+  switch (stage) {
+
+  case HASH_MOVE:
+    stage++;
+    attack_info.update(pos);
+    if (MoveGenerator::is_pseudo_legal(pos, tt_move, attack_info) && MoveGenerator::is_legal(pos, tt_move, attack_info)) {
+      return tt_move;
+    }
+    [[fallthrough]];
+
+  case GENERATE_CAPTURES:
+    move_gen.count = 0;
+    move_gen.set_ordering(killers, quiet_history);
+    move_gen.append<CAPTURES>(pos);
+    captures_end = move_gen.count;
+    current = 0;
+    stage++;
+    [[fallthrough]];
+
+  case GOOD_CAPTURES:
+    while (current < captures_end) {
+      pick_best(current, captures_end);
+
+      // Everything from here on loses material, searched after the quiets
+      if (move_gen.moves[current].score < 0) break;
+
+      Move move = move_gen.moves[current++].move;
+      if (!(move == tt_move)) return move;
+    }
+    bad_current = current;
+    stage++;
+    [[fallthrough]];
+
+  case KILLERS:
+    while (killer_index < 2) {
+      Move killer = killers[killer_index++];
+
+      // Killers come from sibling nodes, so they may be captures or not even possible here
+      if (killer == tt_move || !MoveGenerator::is_pseudo_legal(pos, killer, attack_info)) continue;
+      if (!MoveGenerator::is_legal(pos, killer, attack_info)) continue;
+      if (pos.piece_list[killer.get_to_sq()] != NO_PIECE) continue;
+      if (killer.get_flags() == EN_PASSANT || killer.get_flags() == PROMO_QUEEN) continue;
+      if (killer_index == 2 && killer == killers[0]) continue;
+
+      return killer;
+    }
+    stage++;
+    [[fallthrough]];
+
+  case GENERATE_QUIETS:
+    if (!skip_quiet_moves) {
+      move_gen.append<QUIETS>(pos);
+      sort_quiets(captures_end, move_gen.count);
+    }
+    current = captures_end;
+    stage++;
+    [[fallthrough]];
+
+  case QUIET_MOVES:
+    while (!skip_quiet_moves && current < move_gen.count) {
+      Move move = move_gen.moves[current++].move;
+      if (!(move == tt_move) && !is_killer(move)) return move;
+    }
+    stage++;
+    [[fallthrough]];
+
+  case BAD_CAPTURES:
+    while (bad_current < captures_end) {
+      pick_best(bad_current, captures_end);
+      Move move = move_gen.moves[bad_current++].move;
+      if (!(move == tt_move)) return move;
+    }
+    stage++;
+    [[fallthrough]];
+
+  case DONE:
+    break;
+  }
+
+  return Move();
+}
+
+void MovePicker::pick_best(int begin, int end) {
+  ScoredMove* moves = move_gen.moves;
+  int best_idx = begin;
+  for (int j = begin + 1; j < end; j++) {
+    if (moves[j].score > moves[best_idx].score) best_idx = j;
+  }
+  std::swap(moves[begin], moves[best_idx]);
+}
+
+// Insertion sort, highest history score first
+void MovePicker::sort_quiets(int begin, int end) {
+  ScoredMove* moves = move_gen.moves;
+  for (int i = begin + 1; i < end; i++) {
+    ScoredMove scored = moves[i];
+    int j = i - 1;
+
+    while (j >= begin && moves[j].score < scored.score) {
+      moves[j + 1] = moves[j];
+      j--;
+    }
+
+    moves[j + 1] = scored;
+  }
+}
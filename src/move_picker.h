@@ -0,0 +1,63 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include "move.h"
+#include "move_generator.h"
+#include "position.h"
+#include "search.h"
+
+// Hands out the moves of a node one at a time. Moves are generated in stages so that a
+// cutoff from the hash move, a capture or a killer never pays for generating the quiets.
+class MovePicker {
+
+public:
+
+  // Moves are generated into buffer, which must hold MAX_MOVES entries and outlive the picker,
+  // attack_info is the node's and computed on first use
+  MovePicker(const Position& pos, Move tt_move, const std::array<Move, 2>& killers, const QuietHistory& history,
+             ScoredMove* buffer, AttackInfo& attack_info);
+
+  // Returns an empty move once every stage is exhausted
+  Move next_move();
+
+  // Drops the quiets that haven't been handed out yet, once the search prunes every remaining quiet
+  inline void skip_quiets() { skip_quiet_moves = true; }
+
+private:
+
+  enum Stage : uint8_t {
+    HASH_MOVE,
+    GENERATE_CAPTURES,
+    GOOD_CAPTURES,
+    KILLERS,
+    GENERATE_QUIETS,
+    QUIET_MOVES,
+    BAD_CAPTURES,
+    DONE
+  };
+
+  const Position& pos;
+  AttackInfo& attack_info;
+  MoveGenerator move_gen;
+  Move tt_move;
+  std::array<Move, 2> killers;
+  QuietHistory quiet_history;
+
+  uint8_t stage = HASH_MOVE;
+  bool skip_quiet_moves = false;
+  uint8_t killer_index = 0;
+
+  // moves holds captures in [0, captures_end) and quiets in [captures_end, move_gen.count)
+  int captures_end = 0;
+  int current = 0;
+  int bad_current = 0;
+
+  // Moves the highest scoring move in [begin, end) to begin
+  void pick_best(int begin, int end);
+  void sort_quiets(int begin, int end);
+
+  inline bool is_killer(Move move) const {
+    return move == killers[0] || move == killers[1];
+  }
+
+};
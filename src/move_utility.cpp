@@ -490,6 +490,45 @@ std::array<uint64_t, 5248> init_bishop_table() {
   return bishop_table;
 }
 
+// Squares strictly between two aligned squares, empty if not aligned
+std::array<std::array<uint64_t, 64>, 64> init_between_table() {
+  std::array<std::array<uint64_t, 64>, 64> between_table = {};
+  for (int from = 0; from < 64; from++) {
+    for (int to = 0; to < 64; to++) {
+      if (from == to)
+        continue;
+      uint64_t from_bb = 1ULL << from;
+      uint64_t to_bb = 1ULL << to;
+      if (generate_rook_attacks_rays(from, 0ULL) & to_bb)
+        between_table[from][to] = generate_rook_attacks_rays(from, to_bb) &
+                                  generate_rook_attacks_rays(to, from_bb);
+      else if (generate_bishop_attacks_rays(from, 0ULL) & to_bb)
+        between_table[from][to] = generate_bishop_attacks_rays(from, to_bb) &
+                                  generate_bishop_attacks_rays(to, from_bb);
+    }
+  }
+  return between_table;
+}
+
+// Full board line through two aligned squares, empty if not aligned
+std::array<std::array<uint64_t, 64>, 64> init_line_table() {
+  std::array<std::array<uint64_t, 64>, 64> line_table = {};
+  for (int from = 0; from < 64; from++) {
+    for (int to = 0; to < 64; to++) {
+      if (from == to)
+        continue;
+      uint64_t ends = (1ULL << from) | (1ULL << to);
+      if (generate_rook_attacks_rays(from, 0ULL) & (1ULL << to))
+        line_table[from][to] = (generate_rook_attacks_rays(from, 0ULL) &
+                                generate_rook_attacks_rays(to, 0ULL)) | ends;
+      else if (generate_bishop_attacks_rays(from, 0ULL) & (1ULL << to))
+        line_table[from][to] = (generate_bishop_attacks_rays(from, 0ULL) &
+                                generate_bishop_attacks_rays(to, 0ULL)) | ends;
+    }
+  }
+  return line_table;
+}
+
 std::array<MoveUtility::MagicEntry, 64> init_rook_magic_entry() {
   std::array<MoveUtility::MagicEntry, 64> rook_magic_entry;
   std::array<uint64_t, 64> rook_masks = init_rook_mask_table();
@@ -528,4 +567,7 @@ const std::array<MagicEntry, 64> BISHOP_MAGIC_ENTRY = init_bishop_magic_entry();
 const std::array<uint64_t, 102400> ROOK_ATTACKS = init_rook_table();
 const std::array<uint64_t, 5248> BISHOP_ATTACKS = init_bishop_table();
 
+const std::array<std::array<uint64_t, 64>, 64> BETWEEN = init_between_table();
+const std::array<std::array<uint64_t, 64>, 64> LINE = init_line_table();
+
 } // namespace MoveUtility
\ No newline at end of file
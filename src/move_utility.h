@@ -54,6 +54,10 @@ extern const std::array<uint64_t, 64> KNIGHT_MOVES;
 extern const std::array<uint64_t, 64> KING_MOVES;
 extern const std::array<std::array<uint64_t, 64>, 2> PAWN_ATTACKS;
 extern const std::array<uint8_t, 64> CASTLING_RIGHTS_UPDATE;
+// BETWEEN[a][b]: squares strictly between a and b, LINE[a][b]: the whole line
+// through both. Both are empty when a and b do not share a rank, file or diagonal
+extern const std::array<std::array<uint64_t, 64>, 64> BETWEEN;
+extern const std::array<std::array<uint64_t, 64>, 64> LINE;
 
 inline uint64_t get_rook_attacks(uint8_t square, uint64_t occupancy) {
 
@@ -0,0 +1,270 @@
+#include "nnue.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "move_utility.h"
+#include "piece.h"
+#include "position.h"
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// File layout, little endian: the header, then the hidden layer's biases and weights
+// ([input][neuron]), then the output bias and weights ([perspective][neuron])
+struct FileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t inputs;
+  uint32_t hidden;
+};
+
+constexpr uint32_t FILE_MAGIC = 0x4E4E5A43; // "CZNN"
+constexpr uint32_t FILE_VERSION = 1;
+
+constexpr size_t HIDDEN_BIASES_OFFSET = sizeof(FileHeader);
+constexpr size_t HIDDEN_WEIGHTS_OFFSET = HIDDEN_BIASES_OFFSET + NNUE::HIDDEN * sizeof(int16_t);
+constexpr size_t OUTPUT_BIAS_OFFSET = HIDDEN_WEIGHTS_OFFSET + NNUE::INPUTS * NNUE::HIDDEN * sizeof(int16_t);
+constexpr size_t OUTPUT_WEIGHTS_OFFSET = OUTPUT_BIAS_OFFSET + sizeof(int32_t);
+constexpr size_t FILE_SIZE = OUTPUT_WEIGHTS_OFFSET + 2 * NNUE::HIDDEN * sizeof(int8_t);
+
+// Pointers into the mapped file
+struct Network {
+  const int16_t* hidden_biases = nullptr;
+  const int16_t* hidden_weights = nullptr;
+  int32_t output_bias = 0;
+  const int8_t* output_weights = nullptr;
+};
+
+Network network;
+void* mapping = nullptr;
+size_t mapping_size = 0;
+std::string network_file;
+bool use_network = true;
+
+#if defined(__AVX2__)
+
+using Vec = __m256i;
+constexpr size_t VEC_LANES = 16;
+inline Vec vec_load(const int16_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+inline void vec_store(int16_t* p, Vec v) { _mm256_storeu_si256((__m256i*)p, v); }
+inline Vec vec_add(Vec a, Vec b) { return _mm256_add_epi16(a, b); }
+inline Vec vec_sub(Vec a, Vec b) { return _mm256_sub_epi16(a, b); }
+
+#elif defined(__SSE4_1__)
+
+using Vec = __m128i;
+constexpr size_t VEC_LANES = 8;
+inline Vec vec_load(const int16_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+inline void vec_store(int16_t* p, Vec v) { _mm_storeu_si128((__m128i*)p, v); }
+inline Vec vec_add(Vec a, Vec b) { return _mm_add_epi16(a, b); }
+inline Vec vec_sub(Vec a, Vec b) { return _mm_sub_epi16(a, b); }
+
+#endif
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+// Neurons kept in registers at once while applying a move's changes
+constexpr size_t TILE_VECS = 8;
+constexpr size_t TILE_LANES = TILE_VECS * VEC_LANES;
+static_assert(NNUE::HIDDEN % TILE_LANES == 0);
+#endif
+
+inline uint8_t orient(uint8_t perspective, uint8_t square) {
+  return perspective == WHITE ? square : square ^ 56;
+}
+
+inline size_t feature_index(uint8_t perspective, uint8_t king_sq, uint8_t piece, uint8_t square) {
+  // Own pieces first, then the opponent's, for each kind
+  size_t kind = ((piece >> 1) << 1) + ((piece & 1) != perspective);
+  return (orient(perspective, king_sq) * NNUE::PIECE_KINDS + kind) * 64 + orient(perspective, square);
+}
+
+inline const int16_t* weight_row(size_t feature) {
+  return network.hidden_weights + feature * NNUE::HIDDEN;
+}
+
+// output = previous - removed rows + added rows
+void apply_rows(const int16_t* previous, int16_t* output, const size_t* removed, size_t removed_count,
+                const size_t* added, size_t added_count) {
+#if defined(__AVX2__) || defined(__SSE4_1__)
+  for (size_t tile = 0; tile < NNUE::HIDDEN; tile += TILE_LANES) {
+    Vec regs[TILE_VECS];
+    for (size_t i = 0; i < TILE_VECS; i++) regs[i] = vec_load(previous + tile + i * VEC_LANES);
+
+    for (size_t r = 0; r < removed_count; r++) {
+      const int16_t* row = weight_row(removed[r]) + tile;
+      for (size_t i = 0; i < TILE_VECS; i++) regs[i] = vec_sub(regs[i], vec_load(row + i * VEC_LANES));
+    }
+    for (size_t a = 0; a < added_count; a++) {
+      const int16_t* row = weight_row(added[a]) + tile;
+      for (size_t i = 0; i < TILE_VECS; i++) regs[i] = vec_add(regs[i], vec_load(row + i * VEC_LANES));
+    }
+
+    for (size_t i = 0; i < TILE_VECS; i++) vec_store(output + tile + i * VEC_LANES, regs[i]);
+  }
+#else
+  std::memcpy(output, previous, NNUE::HIDDEN * sizeof(int16_t));
+  for (size_t r = 0; r < removed_count; r++) {
+    const int16_t* row = weight_row(removed[r]);
+    for (size_t i = 0; i < NNUE::HIDDEN; i++) output[i] -= row[i];
+  }
+  for (size_t a = 0; a < added_count; a++) {
+    const int16_t* row = weight_row(added[a]);
+    for (size_t i = 0; i < NNUE::HIDDEN; i++) output[i] += row[i];
+  }
+#endif
+}
+
+// Sum of clamp(values[i], 0, QA) * weights[i], the int8 weights widened to int16 so
+// products of pairs add up in int32 lanes
+int32_t output_dot(const int16_t* values, const int8_t* weights) {
+#if defined(__AVX2__)
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i qa = _mm256_set1_epi16(NNUE::QA);
+  __m256i sum = _mm256_setzero_si256();
+  for (size_t i = 0; i < NNUE::HIDDEN; i += 16) {
+    __m256i v = _mm256_min_epi16(_mm256_max_epi16(_mm256_loadu_si256((const __m256i*)(values + i)), zero), qa);
+    __m256i w = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(weights + i)));
+    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(v, w));
+  }
+  __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+  half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+  half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+  return _mm_cvtsi128_si32(half);
+#elif defined(__SSE4_1__)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i qa = _mm_set1_epi16(NNUE::QA);
+  __m128i sum = _mm_setzero_si128();
+  for (size_t i = 0; i < NNUE::HIDDEN; i += 8) {
+    __m128i v = _mm_min_epi16(_mm_max_epi16(_mm_loadu_si128((const __m128i*)(values + i)), zero), qa);
+    __m128i w = _mm_cvtepi8_epi16(_mm_loadl_epi64((const __m128i*)(weights + i)));
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(v, w));
+  }
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+  return _mm_cvtsi128_si32(sum);
+#else
+  int32_t sum = 0;
+  for (size_t i = 0; i < NNUE::HIDDEN; i++) {
+    sum += std::clamp<int32_t>(values[i], 0, NNUE::QA) * weights[i];
+  }
+  return sum;
+#endif
+}
+
+void unmap() {
+  if (mapping) munmap(mapping, mapping_size);
+  mapping = nullptr;
+  mapping_size = 0;
+  network = Network();
+  network_file.clear();
+}
+
+}
+
+namespace NNUE {
+
+bool load(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || (size_t)file_stat.st_size != FILE_SIZE) {
+    close(fd);
+    return false;
+  }
+
+  void* data = mmap(nullptr, FILE_SIZE, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return false;
+
+  FileHeader header;
+  std::memcpy(&header, data, sizeof(header));
+  if (header.magic != FILE_MAGIC || header.version != FILE_VERSION || header.inputs != INPUTS
+      || header.hidden != HIDDEN) {
+    munmap(data, FILE_SIZE);
+    return false;
+  }
+
+  // Every weight row is read for refreshes soon after loading
+  madvise(data, FILE_SIZE, MADV_WILLNEED);
+
+  unmap();
+  mapping = data;
+  mapping_size = FILE_SIZE;
+  network_file = path;
+
+  const char* bytes = (const char*)data;
+  network.hidden_biases = (const int16_t*)(bytes + HIDDEN_BIASES_OFFSET);
+  network.hidden_weights = (const int16_t*)(bytes + HIDDEN_WEIGHTS_OFFSET);
+  std::memcpy(&network.output_bias, bytes + OUTPUT_BIAS_OFFSET, sizeof(int32_t));
+  network.output_weights = (const int8_t*)(bytes + OUTPUT_WEIGHTS_OFFSET);
+  return true;
+}
+
+const std::string& loaded_file() {
+  return network_file;
+}
+
+void set_enabled(bool enabled) {
+  use_network = enabled;
+}
+
+bool is_active() {
+  return use_network && mapping != nullptr;
+}
+
+void refresh(const Position& pos, Accumulator& acc, uint8_t perspective) {
+  uint8_t king_sq = MoveUtility::get_lsbit_index(pos.all_piece_bitboards[WHITE_KING + perspective]);
+
+  // At most 30 pieces besides the kings
+  std::array<size_t, 32> features;
+  size_t count = 0;
+  uint64_t pieces = pos.total_bb & ~(pos.all_piece_bitboards[WHITE_KING] | pos.all_piece_bitboards[BLACK_KING]);
+  while (pieces) {
+    uint8_t square = MoveUtility::get_lsbit_index(pieces);
+    pieces &= pieces - 1;
+    features[count++] = feature_index(perspective, king_sq, pos.piece_list[square], square);
+  }
+
+  apply_rows(network.hidden_biases, acc.values[perspective].data(), nullptr, 0, features.data(), count);
+  acc.computed[perspective] = true;
+}
+
+void update(const Accumulator& previous, Accumulator& acc, uint8_t perspective, uint8_t king_sq) {
+  std::array<size_t, 3> removed;
+  std::array<size_t, 3> added;
+  size_t removed_count = 0;
+  size_t added_count = 0;
+
+  const DirtyPiece& dirty = acc.dirty;
+  for (uint8_t i = 0; i < dirty.count; i++) {
+    uint8_t piece = dirty.piece[i];
+    if ((piece >> 1) == KING) continue;
+    if (dirty.from[i] != 64) removed[removed_count++] = feature_index(perspective, king_sq, piece, dirty.from[i]);
+    if (dirty.to[i] != 64) added[added_count++] = feature_index(perspective, king_sq, piece, dirty.to[i]);
+  }
+
+  apply_rows(previous.values[perspective].data(), acc.values[perspective].data(), removed.data(), removed_count,
+             added.data(), added_count);
+  acc.computed[perspective] = true;
+}
+
+int32_t evaluate(const Position& pos, const Accumulator& acc) {
+  uint8_t us = pos.side_to_move;
+  int32_t output = network.output_bias + output_dot(acc.values[us].data(), network.output_weights) +
+                   output_dot(acc.values[us ^ 1].data(), network.output_weights + HIDDEN);
+  int32_t score = (int64_t)output * OUTPUT_SCALE / (QA * QB);
+  return std::clamp(score, -MAX_EVAL, MAX_EVAL);
+}
+
+} // namespace NNUE
@@ -0,0 +1,62 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "position.h"
+
+// Efficiently updatable neural network evaluation. Each side's perspective has one input per
+// (own king square, non-king piece, square), king squares and the board mirrored vertically
+// for black, feeding a HIDDEN wide int16 layer. The two halves, side to move first, are
+// clipped to [0, QA] and go through int8 output weights to a single score.
+namespace NNUE {
+
+constexpr size_t KING_SQUARES = 64;
+// White and black pawn, knight, bishop, rook and queen
+constexpr size_t PIECE_KINDS = 10;
+constexpr size_t INPUTS = KING_SQUARES * PIECE_KINDS * 64;
+constexpr size_t HIDDEN = 256;
+
+// Quantization: an activation of 1.0 is QA in the hidden layer, an output weight of 1.0 is QB,
+// and the network's output times OUTPUT_SCALE is the score in centipawns
+constexpr int32_t QA = 127;
+constexpr int32_t QB = 64;
+constexpr int32_t OUTPUT_SCALE = 400;
+// Network output is clamped well inside the mate scores
+constexpr int32_t MAX_EVAL = 20000;
+
+constexpr const char* DEFAULT_EVAL_FILE = "cheezy.nnue";
+
+// Hidden layer values of one position for both perspectives. The search keeps one per ply
+// and updates it from the one before with the pieces the move changed, so unmaking a move
+// only means going back to the previous ply's accumulator.
+struct alignas(64) Accumulator {
+  // [perspective][neuron]
+  std::array<std::array<int16_t, HIDDEN>, 2> values;
+  std::array<bool, 2> computed = {false, false};
+  // Pieces changed by the move that led here from the previous ply
+  DirtyPiece dirty;
+};
+
+// Maps the network file into memory, replacing the current network only if the file is valid.
+// Must not be called while a search is running.
+bool load(const std::string& path);
+const std::string& loaded_file();
+
+// Runtime switch between the network and the PST evaluation, on by default
+void set_enabled(bool enabled);
+
+// Whether the search should use the network: switched on and a network loaded
+bool is_active();
+
+// Computes the perspective's half of acc from every piece on the board
+void refresh(const Position& pos, Accumulator& acc, uint8_t perspective);
+
+// Computes the perspective's half of acc from the previous ply's and acc.dirty. Only valid while
+// the perspective's king, on king_sq, hasn't moved, otherwise every input changes.
+void update(const Accumulator& previous, Accumulator& acc, uint8_t perspective, uint8_t king_sq);
+
+// Score for the side to move in centipawns, from an accumulator computed for both perspectives
+int32_t evaluate(const Position& pos, const Accumulator& acc);
+
+} // namespace NNUE
@@ -0,0 +1,148 @@
+#include "pawns.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "evaluation.h"
+#include "move_utility.h"
+#include "piece.h"
+#include "position.h"
+
+using namespace MoveUtility;
+using Evaluation::make_score;
+using Evaluation::Score;
+
+namespace {
+
+constexpr Score DOUBLED = make_score(-10, -25);
+constexpr Score ISOLATED = make_score(-5, -15);
+constexpr Score BACKWARD = make_score(-8, -12);
+// [relative rank]
+constexpr std::array<Score, 8> PASSED = {
+  make_score(0, 0), make_score(5, 10), make_score(10, 15), make_score(15, 25),
+  make_score(30, 50), make_score(50, 90), make_score(90, 150), make_score(0, 0)
+};
+
+// Own pawns on the three files around the king, one and two ranks in front of it
+constexpr Score SHIELD_NEAR = make_score(15, 0);
+constexpr Score SHIELD_FAR = make_score(8, 0);
+// Per file of the three without an own pawn in front of the king
+constexpr Score OPEN_FILE_NEAR_KING = make_score(-15, 0);
+
+inline uint64_t north_fill(uint64_t b) {
+  b |= b << 8;
+  b |= b << 16;
+  return b | (b << 32);
+}
+
+inline uint64_t south_fill(uint64_t b) {
+  b |= b >> 8;
+  b |= b >> 16;
+  return b | (b >> 32);
+}
+
+inline uint64_t east_one(uint64_t b) { return (b << 1) & ~FILE_A; }
+inline uint64_t west_one(uint64_t b) { return (b >> 1) & ~FILE_H; }
+
+// Squares in front of the pawns, in their direction of travel
+inline uint64_t front_span(uint64_t pawns, uint8_t color) {
+  return color == WHITE ? north_fill(pawns) << 8 : south_fill(pawns) >> 8;
+}
+
+inline uint64_t pawn_attacks(uint64_t pawns, uint8_t color) {
+  uint64_t pushed = color == WHITE ? pawns << 8 : pawns >> 8;
+  return east_one(pushed) | west_one(pushed);
+}
+
+inline uint64_t file_fill(uint64_t b) {
+  return north_fill(b) | south_fill(b);
+}
+
+inline int32_t popcount(uint64_t b) {
+  return count_bits(b);
+}
+
+// Structure terms of color's pawns, positive is good for color
+Score evaluate_side(PawnEntry& entry, uint64_t own, uint64_t their, uint8_t color) {
+  uint8_t them = color ^ 1;
+  Score score = 0;
+
+  // The rear pawn of a doubled pair is the one with an own pawn in front
+  uint64_t rear_span = front_span(own, them);
+  score += DOUBLED * popcount(own & rear_span);
+
+  uint64_t own_files = file_fill(own);
+  uint64_t isolated = own & ~(east_one(own_files) | west_one(own_files));
+  score += ISOLATED * popcount(isolated);
+
+  // Stop square covered by an enemy pawn and no own pawn left behind to ever defend it
+  uint64_t stops = color == WHITE ? own << 8 : own >> 8;
+  uint64_t blocked_stops = stops & entry.attacks[them] & ~entry.attack_span[color];
+  uint64_t backward = (color == WHITE ? blocked_stops >> 8 : blocked_stops << 8) & ~isolated;
+  score += BACKWARD * popcount(backward);
+
+  // No enemy pawn in front on the same or an adjacent file, and no own pawn in front either
+  uint64_t their_span = front_span(their, them);
+  uint64_t passed = own & ~(their_span | east_one(their_span) | west_one(their_span)) & ~rear_span;
+  entry.passed[color] = passed;
+  while (passed) {
+    uint8_t square = get_lsbit_index(passed);
+    passed &= passed - 1;
+    uint8_t relative_rank = color == WHITE ? square >> 3 : 7 - (square >> 3);
+    score += PASSED[relative_rank];
+  }
+
+  return score;
+}
+
+}
+
+PawnTable::PawnTable() : entries(ENTRY_COUNT) {}
+
+void PawnTable::clear() {
+  std::fill(entries.begin(), entries.end(), PawnEntry());
+}
+
+PawnEntry* PawnTable::probe(const Position& pos) {
+  PawnEntry& entry = entries[pos.pawn_key & (ENTRY_COUNT - 1)];
+  if (entry.key == pos.pawn_key) return &entry;
+
+  uint64_t white = pos.all_piece_bitboards[WHITE_PAWN];
+  uint64_t black = pos.all_piece_bitboards[BLACK_PAWN];
+
+  entry = PawnEntry();
+  entry.key = pos.pawn_key;
+  entry.attacks = {pawn_attacks(white, WHITE), pawn_attacks(black, BLACK)};
+  entry.attack_span = {north_fill(entry.attacks[WHITE]), south_fill(entry.attacks[BLACK])};
+  entry.score = evaluate_side(entry, white, black, WHITE) - evaluate_side(entry, black, white, BLACK);
+  return &entry;
+}
+
+Score PawnEntry::king_shelter(const Position& pos, uint8_t color) {
+  uint8_t king_sq = get_lsbit_index(pos.all_piece_bitboards[WHITE_KING + color]);
+  if (shelter_king_sq[color] == king_sq) return shelter[color];
+
+  uint64_t own = pos.all_piece_bitboards[WHITE_PAWN + color];
+  uint8_t rank = king_sq >> 3;
+  // A king on the edge is sheltered by the same three files as one next to it
+  uint8_t center = std::clamp(king_sq & 7, 1, 6);
+  uint64_t in_front = front_span(RANK_1 << (8 * rank), color);
+
+  Score score = 0;
+  for (uint8_t file = center - 1; file <= center + 1; file++) {
+    uint64_t file_pawns = own & in_front & (FILE_A << file);
+    if (!file_pawns) score += OPEN_FILE_NEAR_KING;
+  }
+
+  uint64_t zone = (FILE_A << (center - 1)) | (FILE_A << center) | (FILE_A << (center + 1));
+  int8_t step = color == WHITE ? 1 : -1;
+  int8_t near_rank = rank + step;
+  int8_t far_rank = rank + 2 * step;
+  if (near_rank >= 0 && near_rank < 8) score += SHIELD_NEAR * popcount(own & zone & (RANK_1 << (8 * near_rank)));
+  if (far_rank >= 0 && far_rank < 8) score += SHIELD_FAR * popcount(own & zone & (RANK_1 << (8 * far_rank)));
+
+  shelter_king_sq[color] = king_sq;
+  shelter[color] = score;
+  return score;
+}
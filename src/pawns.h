@@ -0,0 +1,45 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "evaluation.h"
+#include "position.h"
+
+// Pawn structure of one pawn key. Everything but the king shelter depends on the pawns
+// alone, so it is computed once and found again through Position::pawn_key.
+struct PawnEntry {
+  uint64_t key = 0;
+  // Doubled, isolated, backward and passed pawns, from white's point of view
+  Evaluation::Score score = 0;
+  // [color]
+  std::array<uint64_t, 2> passed = {0, 0};
+  std::array<uint64_t, 2> attacks = {0, 0};
+  // Squares the pawns attack now or could attack after advancing
+  std::array<uint64_t, 2> attack_span = {0, 0};
+  // [color], pawn shield in front of the king square it was last computed for, 64 if never
+  std::array<uint8_t, 2> shelter_king_sq = {64, 64};
+  std::array<Evaluation::Score, 2> shelter = {0, 0};
+
+  // Shield of color's king, recomputed only after that king moved
+  Evaluation::Score king_shelter(const Position& pos, uint8_t color);
+};
+
+// Each search thread owns one, so entries are read and written without locking. Hits are
+// the norm: the pawn structure rarely changes between neighbouring nodes.
+class PawnTable {
+
+public:
+
+  PawnTable();
+
+  // Entry for pos's pawns, evaluated first on a miss
+  PawnEntry* probe(const Position& pos);
+  void clear();
+
+private:
+
+  static constexpr size_t ENTRY_COUNT = 16384;
+  std::vector<PawnEntry> entries;
+
+};
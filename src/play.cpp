@@ -1,64 +1,62 @@
 #include <iostream>
 #include <string>
+#include <vector>
+#include "bench.h"
 #include "position.h"
 #include "search.h"
+#include "thread_pool.h"
 #include "move_generator.h"
-
-std::string move_to_string(const Move& move) {
-  std::string move_str = "";
-  uint8_t from_sq = move.get_from_sq();
-  uint8_t to_sq = move.get_to_sq();
-  uint8_t flags = move.get_flags();
-
-  uint8_t from_file = from_sq % 8;
-  uint8_t from_rank = from_sq / 8;
-
-  uint8_t to_file = to_sq % 8;
-  uint8_t to_rank = to_sq / 8;
-
-  char from_file_chr = from_file + 'a';
-  char from_rank_chr = from_rank + '1';
-
-  char to_file_chr = to_file + 'a';
-  char to_rank_chr = to_rank + '1';
-
-  move_str += from_file_chr;
-  move_str += from_rank_chr;
-  move_str += to_file_chr;
-  move_str += to_rank_chr;
-
-  if (flags <= PROMO_QUEEN && flags >= PROMO_KNIGHT) {
-    char promo_char;
-    if (flags == PROMO_KNIGHT) promo_char = 'n';
-    if (flags == PROMO_BISHOP) promo_char = 'b';
-    if (flags == PROMO_ROOK) promo_char = 'r';
-    if (flags == PROMO_QUEEN) promo_char = 'q';
-
-    move_str += promo_char;
+#include "move_utility.h"
+#include "nnue.h"
+#include "uci.h"
+
+using UCI::move_to_string;
+using UCI::string_to_move;
+
+void print_search_result(const Search& srch) {
+  std::cout << "Depth: " << (int)srch.completed_depth << " Score: " << srch.best_score
+            << " Nodes: " << Threads.nodes_searched() << " PV:";
+  for (const Move& move : srch.principal_variation) {
+    std::cout << " " << move_to_string(move);
   }
-
-  return move_str;
+  std::cout << std::endl;
 }
 
-Move string_to_move(std::string move_str, Position& pos) {
+// Ponders on the reply the last search expects to our move, returns that reply or an empty move
+Move start_pondering(const Position& pos, Move our_move, const SearchLimits& limits) {
+  const std::vector<Move>& pv = Threads.best_thread().principal_variation;
+  if (pv.size() < 2 || !(pv[0] == our_move)) return Move();
+
+  Move expected_reply = pv[1];
+  AttackInfo attack_info;
+  attack_info.compute(pos);
+  if (!MoveGenerator::is_pseudo_legal(pos, expected_reply, attack_info) ||
+      !MoveGenerator::is_legal(pos, expected_reply, attack_info)) {
+    return Move();
+  }
 
-  MoveGenerator mg;
-  std::array<Move, 2> null_killer = {Move()};
-  std::array<std::array<int32_t, 64>, 12> null_history = {0};
-  mg.generate(pos, null_killer, null_history);
+  Position ponder_pos = pos;
+  ponder_pos.make_move(expected_reply);
+  Threads.start_search(ponder_pos, limits, true);
+  return expected_reply;
+}
 
-  for (int i = 0; i < mg.count; i++) {
-    Move legal_move = mg.move_list[i];
+// The search returns an empty move when there is no legal move
+bool report_game_over(const Position& pos, Move best_move) {
+  if (best_move.move_data != 0) return false;
 
-    if (move_str == move_to_string(legal_move)) {
-      return legal_move;
-    }
+  uint8_t king_sq = MoveUtility::get_lsbit_index(pos.all_piece_bitboards[WHITE_KING + pos.side_to_move]);
+  if (MoveGenerator::is_square_attacked(pos, king_sq, pos.side_to_move)) {
+    std::cout << "Mated" << std::endl;
+  } else {
+    std::cout << "Stalemate" << std::endl;
   }
-
-  return Move();
+  return true;
 }
 
-int main() {
+// Prompt driven game against the engine at a fixed depth
+void play() {
+
   std::string fen_string;
   std::cout << "Please enter fen string: ";
   std::getline(std::cin, fen_string);
@@ -69,6 +67,7 @@ int main() {
   Move best_move;
   char user_side;
   std::string depth_str;
+  std::string threads_str;
   int depth;
 
   bool wrong_char = true;
@@ -77,16 +76,25 @@ int main() {
   std::cin >> depth_str;
   depth = std::stoi(depth_str);
 
-  Search srch;
+  std::cout << "Please enter number of threads: ";
+  std::cin >> threads_str;
+  Threads.set_threads(std::stoi(threads_str));
+
+  SearchLimits limits;
+  limits.depth = depth;
+  Move expected_reply;
 
   while (true) {
     std::cout << "Please enter the side you will be playing as (w/b): ";
     std::cin >> user_side;
     user_side = (user_side == 'w') ? 0 : 1;
     if (user_side != pos.side_to_move) {
-      best_move = srch.negamax_root(pos, depth);
+      best_move = Threads.search(pos, limits);
+      if (report_game_over(pos, best_move)) return;
       pos.make_move(best_move);
       std::cout << "My move: " << move_to_string(best_move) << std::endl;
+      print_search_result(Threads.best_thread());
+      expected_reply = start_pondering(pos, best_move, limits);
       break;
     } else if (user_side == pos.side_to_move) {
       break;
@@ -96,14 +104,29 @@ int main() {
   while (true) {
     std::string user_move_str;
     std::cout << "Please enter your move: ";
-    std::cin >> user_move_str;
+    if (!(std::cin >> user_move_str)) break;
     Move user_move = string_to_move(user_move_str, pos);
     if (user_move.move_data != 0) {
 
       pos.make_move(user_move);
-      best_move = srch.negamax_root(pos, depth);
+
+      // The ponder search already has a head start on the position after the expected reply
+      if (Threads.is_searching() && user_move == expected_reply) {
+        Threads.ponder_hit();
+        best_move = Threads.wait_for_search();
+      } else {
+        if (Threads.is_searching()) {
+          Threads.stop();
+          Threads.wait_for_search();
+        }
+        best_move = Threads.search(pos, limits);
+      }
+
+      if (report_game_over(pos, best_move)) break;
       pos.make_move(best_move);
       std::cout << "My move: " << move_to_string(best_move) << std::endl;
+      print_search_result(Threads.best_thread());
+      expected_reply = start_pondering(pos, best_move, limits);
 
     } else {
       std::cout << "Not a legal move" << std::endl;
@@ -111,5 +134,31 @@ int main() {
     }
   }
 
+  if (Threads.is_searching()) {
+    Threads.stop();
+    Threads.wait_for_search();
+  }
+}
+
+// cheezy-engine           UCI, for GUIs and tournament managers
+// cheezy-engine play      interactive game in the terminal
+// cheezy-engine bench [depth] [threads] [epd file]
+int main(int argc, char* argv[]) {
+  std::string mode = (argc > 1) ? argv[1] : "";
+
+  // Without a network the PST evaluation is used, EvalFile can load one later
+  NNUE::load(NNUE::DEFAULT_EVAL_FILE);
+
+  if (mode == "bench") {
+    uint8_t depth = (argc > 2) ? std::stoi(argv[2]) : Bench::DEFAULT_DEPTH;
+    size_t threads = (argc > 3) ? std::stoi(argv[3]) : 1;
+    std::string epd_file = (argc > 4) ? argv[4] : "";
+    Bench::run(depth, threads, epd_file);
+  } else if (mode == "play") {
+    play();
+  } else {
+    UCI::loop();
+  }
+
   return 0;
 }
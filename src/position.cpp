@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <array>
 #include <cstdint>
 #include <cmath>
@@ -6,6 +7,8 @@
 #include "move_utility.h"
 #include <iostream>
 #include "position.h"
+#include "evaluation.h"
+#include "zobrist.h"
 
 // FEN constructor
 Position::Position(std::string fen_string) {
@@ -35,6 +38,11 @@ Position::Position(std::string fen_string) {
   } else {
     side_to_move = BLACK;
   }
+
+  ply = 0;
+  zobrist_key = compute_zobrist_key();
+  pawn_key = compute_pawn_key();
+  compute_psq();
 }
 
 Position::Position() {
@@ -125,6 +133,51 @@ Position::Position() {
 
   // BLACK KING
   piece_list[60] = BLACK_KING;
+
+  halfmove_clock = 0;
+  fullmove_count = 1;
+  zobrist_key = compute_zobrist_key();
+  pawn_key = compute_pawn_key();
+  compute_psq();
+}
+
+void Position::compute_psq() {
+  psq_score = 0;
+  game_phase = 0;
+  for (uint8_t square = 0; square < 64; square++) {
+    uint8_t piece = piece_list[square];
+    if (piece == NO_PIECE) continue;
+    psq_score += Evaluation::PSQT[piece][square];
+    game_phase += Evaluation::GAME_PHASE_INCREMENT[piece];
+  }
+}
+
+uint64_t Position::compute_zobrist_key() const {
+  uint64_t key = 0;
+
+  for (uint8_t square = 0; square < 64; square++) {
+    if (piece_list[square] != NO_PIECE) key ^= Zobrist::PIECE_KEYS[piece_list[square]][square];
+  }
+
+  key ^= Zobrist::CASTLING_KEYS[castling_rights];
+  if (en_passant_sq != MoveUtility::NO_SQUARE) key ^= Zobrist::EN_PASSANT_KEYS[en_passant_sq & 7];
+  if (side_to_move == BLACK) key ^= Zobrist::SIDE_KEY;
+
+  return key;
+}
+
+uint64_t Position::compute_pawn_key() const {
+  uint64_t key = 0;
+
+  for (uint8_t piece : {WHITE_PAWN, BLACK_PAWN}) {
+    uint64_t pawns = all_piece_bitboards[piece];
+    while (pawns) {
+      key ^= Zobrist::PIECE_KEYS[piece][MoveUtility::get_lsbit_index(pawns)];
+      pawns &= pawns - 1;
+    }
+  }
+
+  return key;
 }
 
 void Position::print_position() {
@@ -195,6 +248,21 @@ void Position::make_move(Move move){
   history_stack[ply].captured_piece_type = captured_piece_type;
   history_stack[ply].en_passant_sq = en_passant_sq;
   history_stack[ply].halfmove_clock = halfmove_clock;
+  history_stack[ply].zobrist_key = zobrist_key;
+  history_stack[ply].pawn_key = pawn_key;
+  history_stack[ply].psq_score = psq_score;
+  history_stack[ply].game_phase = game_phase;
+
+  uint64_t key = zobrist_key;
+  key ^= Zobrist::PIECE_KEYS[moving_piece_type][from_sq] ^ Zobrist::PIECE_KEYS[moving_piece_type][to_sq];
+  psq_score += Evaluation::PSQT[moving_piece_type][to_sq] - Evaluation::PSQT[moving_piece_type][from_sq];
+  key ^= Zobrist::CASTLING_KEYS[castling_rights];
+  dirty_piece.count = 0;
+  add_dirty_piece(moving_piece_type, from_sq, to_sq);
+  if ((moving_piece_type >> 1) == PAWN) {
+    pawn_key ^= Zobrist::PIECE_KEYS[moving_piece_type][from_sq] ^ Zobrist::PIECE_KEYS[moving_piece_type][to_sq];
+  }
+  if (en_passant_sq != 64) key ^= Zobrist::EN_PASSANT_KEYS[en_passant_sq & 7];
 
   // Move moving piece
   all_piece_bitboards[moving_piece_type] ^= move_mask;
@@ -206,6 +274,11 @@ void Position::make_move(Move move){
   if (captured_piece_type < NO_PIECE) {
     all_piece_bitboards[captured_piece_type] ^= to_bit;
     occupancy_bitboards[captured_piece_type & 1] ^= to_bit;
+    key ^= Zobrist::PIECE_KEYS[captured_piece_type][to_sq];
+    psq_score -= Evaluation::PSQT[captured_piece_type][to_sq];
+    game_phase -= Evaluation::GAME_PHASE_INCREMENT[captured_piece_type];
+    add_dirty_piece(captured_piece_type, to_sq, 64);
+    if ((captured_piece_type >> 1) == PAWN) pawn_key ^= Zobrist::PIECE_KEYS[captured_piece_type][to_sq];
   }
 
   // Update Piece Lists
@@ -225,9 +298,12 @@ void Position::make_move(Move move){
   if ((moving_piece_type >> 1) == PAWN) {
     if (std::abs((int)to_sq - (int)from_sq) == 16) {
       en_passant_sq = (from_sq + to_sq) >> 1;
+      key ^= Zobrist::EN_PASSANT_KEYS[en_passant_sq & 7];
     } 
   }
 
+  key ^= Zobrist::CASTLING_KEYS[castling_rights];
+
   if (flags) {
     if (flags == CASTLE_KINGSIDE) {
 
@@ -239,6 +315,12 @@ void Position::make_move(Move move){
       piece_list[to_sq + 1] = NO_PIECE;
       piece_list[to_sq - 1] = WHITE_ROOK + side_to_move;
 
+      key ^= Zobrist::PIECE_KEYS[WHITE_ROOK + side_to_move][to_sq + 1] ^
+             Zobrist::PIECE_KEYS[WHITE_ROOK + side_to_move][to_sq - 1];
+      psq_score += Evaluation::PSQT[WHITE_ROOK + side_to_move][to_sq - 1] -
+                   Evaluation::PSQT[WHITE_ROOK + side_to_move][to_sq + 1];
+      add_dirty_piece(WHITE_ROOK + side_to_move, to_sq + 1, to_sq - 1);
+
     } else if (flags == CASTLE_QUEENSIDE) {
 
       uint64_t rook_mask = (1ULL << (to_sq - 2)) | (1ULL << (to_sq + 1));
@@ -249,6 +331,12 @@ void Position::make_move(Move move){
       piece_list[to_sq - 2] = NO_PIECE;
       piece_list[to_sq + 1] = WHITE_ROOK + side_to_move;
 
+      key ^= Zobrist::PIECE_KEYS[WHITE_ROOK + side_to_move][to_sq - 2] ^
+             Zobrist::PIECE_KEYS[WHITE_ROOK + side_to_move][to_sq + 1];
+      psq_score += Evaluation::PSQT[WHITE_ROOK + side_to_move][to_sq + 1] -
+                   Evaluation::PSQT[WHITE_ROOK + side_to_move][to_sq - 2];
+      add_dirty_piece(WHITE_ROOK + side_to_move, to_sq - 2, to_sq + 1);
+
     } else if (flags == EN_PASSANT) {
 
       uint8_t captured_sq = to_sq - 8 + (side_to_move << 4);
@@ -258,6 +346,11 @@ void Position::make_move(Move move){
       occupancy_bitboards[BLACK - side_to_move] ^= captured_bb;
       piece_list[captured_sq] = NO_PIECE;
 
+      key ^= Zobrist::PIECE_KEYS[BLACK_PAWN - side_to_move][captured_sq];
+      psq_score -= Evaluation::PSQT[BLACK_PAWN - side_to_move][captured_sq];
+      add_dirty_piece(BLACK_PAWN - side_to_move, captured_sq, 64);
+      pawn_key ^= Zobrist::PIECE_KEYS[BLACK_PAWN - side_to_move][captured_sq];
+
     } else if (flags >= PROMO_KNIGHT && flags <= PROMO_QUEEN) {
 
       uint8_t promo_piece_type = (flags << 1) + side_to_move;
@@ -266,6 +359,14 @@ void Position::make_move(Move move){
       all_piece_bitboards[promo_piece_type] ^= to_bit;
 
       piece_list[to_sq] = promo_piece_type;
+
+      key ^= Zobrist::PIECE_KEYS[moving_piece_type][to_sq] ^ Zobrist::PIECE_KEYS[promo_piece_type][to_sq];
+      psq_score += Evaluation::PSQT[promo_piece_type][to_sq] - Evaluation::PSQT[moving_piece_type][to_sq];
+      game_phase += Evaluation::GAME_PHASE_INCREMENT[promo_piece_type];
+      // The pawn leaves the board and the new piece appears on the promotion square
+      dirty_piece.to[0] = 64;
+      add_dirty_piece(promo_piece_type, 64, to_sq);
+      pawn_key ^= Zobrist::PIECE_KEYS[moving_piece_type][to_sq];
     }
   }
 
@@ -277,6 +378,7 @@ void Position::make_move(Move move){
 
   total_bb = occupancy_bitboards[WHITE] | occupancy_bitboards[BLACK];
   side_to_move ^= 1;
+  zobrist_key = key ^ Zobrist::SIDE_KEY;
   ply++;
 }
 
@@ -357,11 +459,74 @@ void Position::unmake_move() {
   }
 
   halfmove_clock = move_record.halfmove_clock;
+  zobrist_key = move_record.zobrist_key;
+  pawn_key = move_record.pawn_key;
+  psq_score = move_record.psq_score;
+  game_phase = move_record.game_phase;
   total_bb = occupancy_bitboards[WHITE] | occupancy_bitboards[BLACK];
 
   ply--;
 }
 
+void Position::make_null_move() {
+
+  UndoInfo& move_record = history_stack[ply];
+  move_record.move = Move();
+  move_record.captured_piece_type = NO_PIECE;
+  move_record.castling_rights = castling_rights;
+  move_record.en_passant_sq = en_passant_sq;
+  move_record.halfmove_clock = halfmove_clock;
+  move_record.zobrist_key = zobrist_key;
+
+  if (en_passant_sq != 64) zobrist_key ^= Zobrist::EN_PASSANT_KEYS[en_passant_sq & 7];
+  zobrist_key ^= Zobrist::SIDE_KEY;
+
+  en_passant_sq = 64;
+  halfmove_clock++;
+  dirty_piece.count = 0;
+  side_to_move ^= 1;
+  ply++;
+}
+
+void Position::unmake_null_move() {
+
+  const UndoInfo& move_record = history_stack[ply-1];
+
+  en_passant_sq = move_record.en_passant_sq;
+  halfmove_clock = move_record.halfmove_clock;
+  zobrist_key = move_record.zobrist_key;
+  side_to_move ^= 1;
+  ply--;
+}
+
+bool Position::is_repetition() const {
+  int irreversible_distance = std::min<int>(halfmove_clock, ply);
+
+  for (int back = 1; back <= irreversible_distance; back++) {
+    const UndoInfo& record = history_stack[ply - back];
+
+    // A null move isn't a real move, positions before it can't be repeated
+    if (record.move.move_data == 0) return false;
+
+    // Only positions with the same side to move, every second ply, can match
+    if (back % 2 == 0 && record.zobrist_key == zobrist_key) return true;
+  }
+  return false;
+}
+
+bool Position::has_insufficient_material() const {
+  if (all_piece_bitboards[WHITE_PAWN] | all_piece_bitboards[BLACK_PAWN] |
+      all_piece_bitboards[WHITE_ROOK] | all_piece_bitboards[BLACK_ROOK] |
+      all_piece_bitboards[WHITE_QUEEN] | all_piece_bitboards[BLACK_QUEEN]) return false;
+
+  uint64_t knights = all_piece_bitboards[WHITE_KNIGHT] | all_piece_bitboards[BLACK_KNIGHT];
+  uint64_t bishops = all_piece_bitboards[WHITE_BISHOP] | all_piece_bitboards[BLACK_BISHOP];
+  if (MoveUtility::count_bits(knights | bishops) <= 1) return true;
+
+  constexpr uint64_t DARK_SQUARES = 0xAA'55'AA'55'AA'55'AA'55ULL;
+  return !knights && (!(bishops & DARK_SQUARES) || !(bishops & ~DARK_SQUARES));
+}
+
 void Position::set_pieces(std::string piece_str) {
 
   all_piece_bitboards.fill(0);
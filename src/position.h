@@ -7,13 +7,25 @@
 #include "move_utility.h"
 #include <iostream>
 
+// Pieces the last move took off, put on or moved around the board, for updating the NNUE
+// accumulators. A square of 64 stands for off the board. The king comes first when it moved.
+struct DirtyPiece {
+  uint8_t count = 0;
+  std::array<uint8_t, 3> piece;
+  std::array<uint8_t, 3> from;
+  std::array<uint8_t, 3> to;
+};
+
 struct UndoInfo {
   Move move;
   uint8_t captured_piece_type;
   uint8_t castling_rights; // 4 bits: white: king and queen side, black: king and queen side
   uint8_t en_passant_sq;
   uint8_t halfmove_clock;
-  // uint8_t zobrist_key;
+  uint64_t zobrist_key;
+  uint64_t pawn_key;
+  int32_t psq_score;
+  int16_t game_phase;
 };
 
 class Position{
@@ -26,10 +38,19 @@ public:
   uint8_t en_passant_sq;
   bool side_to_move;
   // If halfmove_clock reaches 100, and side_to_move has at least 1 legal move,
-  // Draw score assigned to that node
+  // Draw score assigned to that node (Search::is_draw)
   uint8_t halfmove_clock;
   uint16_t fullmove_count;
   uint16_t ply;
+  uint64_t zobrist_key;
+  // Zobrist keys of the pawns only, indexes the pawn structure cache
+  uint64_t pawn_key;
+  // Evaluation::Score sum of Evaluation::PSQT over every piece, kept up to date by make_move
+  int32_t psq_score;
+  // Sum of Evaluation::GAME_PHASE_INCREMENT over every piece
+  int16_t game_phase;
+  // Written by make_move and make_null_move, not restored by unmaking
+  DirtyPiece dirty_piece;
 
   std::array<UndoInfo, 2048> history_stack;
   std::array<uint8_t, 64> piece_list;
@@ -47,7 +68,37 @@ public:
 
   void unmake_move();
 
+  // Passes the turn, recorded in history_stack with an empty move
+  void make_null_move();
+  void unmake_null_move();
+
+  inline bool last_move_was_null() const {
+    return ply > 0 && history_stack[ply - 1].move.move_data == 0;
+  }
+
+  // Whether this position already occurred since the last capture, pawn move or null move,
+  // found through the keys saved in history_stack
+  bool is_repetition() const;
+
+  // Neither side can ever mate: no pawns, rooks or queens, and at most one minor
+  // piece or only bishops all on the same square color
+  bool has_insufficient_material() const;
+
+  // Full recomputation, used on setup and for debugging the incremental key
+  uint64_t compute_zobrist_key() const;
+  uint64_t compute_pawn_key() const;
+
+  // Full recomputation of psq_score and game_phase, used on setup
+  void compute_psq();
+
 private:
+  inline void add_dirty_piece(uint8_t piece, uint8_t from, uint8_t to) {
+    dirty_piece.piece[dirty_piece.count] = piece;
+    dirty_piece.from[dirty_piece.count] = from;
+    dirty_piece.to[dirty_piece.count] = to;
+    dirty_piece.count++;
+  }
+
   void set_pieces(std::string piece_str);
 
   void set_castling(std::string castle_string);
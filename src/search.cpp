@@ -4,150 +4,681 @@
 #include "position.h"
 #include "evaluation.h"
 #include "move_generator.h"
+#include "move_picker.h"
+#include "nnue.h"
 #include "search.h"
+#include "transposition_table.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <cstdint>
-#include <iostream>
+#include <cstdlib>
 
 
 
 // MOVE ORDERING:
-//   For each move generated, assign a mvv_lva score to the score_list
+//   For each move generated, assign a mvv_lva score next to it in the ply's move buffer
 //   Search the move with the highest score
 //   If no cutoff occurs, search the move with the second highest score and so on
 
 using namespace MoveUtility;
 
+SearchParams Params;
+
+namespace {
+
+// Late move reductions, [depth][move_number], grows with log(depth) * log(move_number)
+std::array<std::array<uint8_t, 64>, 64> init_reduction_table() {
+  std::array<std::array<uint8_t, 64>, 64> table = {};
+  for (int depth = 1; depth < 64; depth++) {
+    for (int move_number = 1; move_number < 64; move_number++) {
+      table[depth][move_number] = (uint8_t)(0.75 + std::log(depth) * std::log(move_number) / 2.25);
+    }
+  }
+  return table;
+}
+
+const std::array<std::array<uint8_t, 64>, 64> REDUCTIONS = init_reduction_table();
+
+inline bool side_to_move_in_check(const Position& pos) {
+  uint8_t king_sq = get_lsbit_index(pos.all_piece_bitboards[WHITE_KING + pos.side_to_move]);
+  return MoveGenerator::is_square_attacked(pos, king_sq, pos.side_to_move);
+}
+
+}
+
 // prioritze faster mate
 // alpha beta pruning
 // handle mates and draws
 int32_t Search::negamax(Position& pos, uint8_t depth, int32_t alpha, int32_t beta) {
-  if (depth == 0) return Evaluation::evaluate_position(pos);
+  pv_length[rel_ply] = rel_ply;
+  if (is_draw(pos)) return 0;
+
+  if (depth == 0) return quiescence(pos, alpha, beta);
+
+  if ((count_node() & (CHECK_INTERVAL - 1)) == 0) check_limits();
+  if (stopped) return 0;
+
+  if (rel_ply >= MAX_PLY - 1) return evaluate(pos);
+
+  // Mate distance pruning: no score here can beat a mate found closer to the root
+  alpha = std::max(alpha, -MATE_SCORE + rel_ply);
+  beta = std::min(beta, MATE_SCORE - rel_ply - 1);
+  if (alpha >= beta) return alpha;
 
   int32_t best_score = -INF;
+  Move best_move;
   int32_t score = 0;
   uint8_t legal_moves = 0;
+  int32_t original_alpha = alpha;
+
+  bool pv_node = beta - alpha > 1;
+
+  // Transposition table cutoff, only outside the PV so the PV is always searched out in full
+  Move tt_move;
+  TTEntry tt_entry;
+  if (TT.probe(pos.zobrist_key, tt_entry)) {
+    tt_move = tt_entry.move;
+    if (!pv_node && tt_entry.depth >= depth) {
+      int32_t tt_score = score_from_tt(tt_entry.score);
+      uint8_t bound = tt_entry.bound();
+      if (bound == BOUND_EXACT ||
+          (bound == BOUND_LOWER && tt_score >= beta) ||
+          (bound == BOUND_UPPER && tt_score <= alpha)) {
+        return tt_score;
+      }
+    }
+  }
 
-  MoveGenerator move_gen;
-  move_gen.generate(pos, killer_heuristic[rel_ply], history_heuristic);
+  // Set by the parent when it made the move
+  bool in_check = stack[rel_ply].in_check;
+  int32_t static_eval = in_check ? -INF : evaluate(pos);
+  stack[rel_ply].static_eval = static_eval;
 
-  for (int i = 0; i < move_gen.count; i++) {
+  if (!pv_node && !in_check) {
 
-    uint8_t best_idx = i;
-    for (uint8_t j = i + 1; j < move_gen.count; j++) {
-      if (move_gen.score_list[j] > move_gen.score_list[best_idx]) best_idx = j;
+    // Reverse futility pruning: too far above beta for the opponent to catch up in the remaining depth
+    if (depth <= Params.reverse_futility_max_depth && std::abs(beta) < MATE_BOUND
+        && static_eval - Params.reverse_futility_margin * depth >= beta) {
+      return static_eval;
     }
-    std::swap(move_gen.move_list[i], move_gen.move_list[best_idx]);
-    std::swap(move_gen.score_list[i], move_gen.score_list[best_idx]);
 
-    Move move = move_gen.move_list[i];
-    pos.make_move(move);
-    rel_ply++;
-    uint8_t king_square = get_lsbit_index(pos.all_piece_bitboards[BLACK_KING - pos.side_to_move]);
+    // Razoring: hopelessly below alpha, drop into quiescence to confirm
+    if (depth <= Params.razor_max_depth && static_eval + Params.razor_margin * depth < alpha) {
+      score = quiescence(pos, alpha - 1, alpha);
+      if (stopped) return 0;
+      if (score < alpha) return score;
+    }
+  }
 
-    if (move_gen.is_square_attacked(pos, king_square, pos.side_to_move^1)) {
-      pos.unmake_move();
+  // Null move pruning: if passing the turn still fails high, a real move almost surely would.
+  // Not when in check, twice in a row, or with only pawns left where zugzwang is common.
+  if (!pv_node && !in_check && depth >= NULL_MOVE_MIN_DEPTH && !pos.last_move_was_null()
+      && has_non_pawn_material(pos, pos.side_to_move)) {
+
+    if (static_eval >= beta) {
+      // Deeper nodes and larger margins over beta allow a bigger reduction
+      uint8_t reduction = 3 + depth / 4 + std::min((static_eval - beta) / 200, 3);
+      uint8_t null_depth = (depth > reduction + 1) ? depth - reduction - 1 : 0;
+
+      set_current_move(Move(), NO_PIECE);
+      pos.make_null_move();
+      rel_ply++;
+      start_ply(pos);
+      stack[rel_ply].in_check = false;
+      score = -negamax(pos, null_depth, -beta, -beta + 1);
+      pos.unmake_null_move();
       rel_ply--;
+
+      if (stopped) return 0;
+
+      // Don't trust unproven mates from a null move search
+      if (score >= beta) return (score >= MATE_BOUND) ? beta : score;
+    }
+  }
+
+  const std::array<Move, 2>& killers = stack[rel_ply].killers;
+  MovePicker move_picker(pos, tt_move, killers, quiet_history(), stack[rel_ply].moves.data(),
+                         stack[rel_ply].attack_info);
+  uint8_t quiets_searched = 0;
+  std::array<Move, MAX_QUIETS_TRIED> quiets_tried;
+
+  // Futility pruning: quiet moves can't raise a frontier node's eval past alpha
+  bool futile = !pv_node && !in_check && depth <= Params.futility_max_depth
+                && static_eval + Params.futility_base + Params.futility_margin * depth <= alpha;
+
+  Move move;
+  while ((move = move_picker.next_move()).move_data != 0) {
+
+    uint8_t flags = move.get_flags();
+    uint8_t moving_piece_type = pos.piece_list[move.get_from_sq()];
+    bool is_quiet = pos.piece_list[move.get_to_sq()] == NO_PIECE && flags != EN_PASSANT
+                    && !(flags >= PROMO_KNIGHT && flags <= PROMO_QUEEN);
+    bool is_killer = move == killers[0] || move == killers[1];
+
+    // Late move pruning: near the leaves, quiet moves this far down the ordering rarely matter
+    if (!pv_node && !in_check && is_quiet && !is_killer && depth <= LMP_MAX_DEPTH
+        && quiets_searched >= LMP_BASE + depth * depth && best_score > -MATE_BOUND) {
+      move_picker.skip_quiets();
+      continue;
+    }
+
+    if (futile && is_quiet && !is_killer && legal_moves > 0) {
+      move_picker.skip_quiets();
       continue;
     }
+
+    int32_t history_score = is_quiet ? quiet_history_score(pos, move) : 0;
+
+    set_current_move(move, moving_piece_type);
+    pos.make_move(move);
+    TT.prefetch(pos.zobrist_key);
+    rel_ply++;
+    start_ply(pos);
     legal_moves++;
+    if (is_quiet && quiets_searched < MAX_QUIETS_TRIED) quiets_tried[quiets_searched++] = move;
+
+    bool gives_check = side_to_move_in_check(pos);
+    stack[rel_ply].in_check = gives_check;
+
+    // Check extension, limited so perpetual checks can't run the search away
+    uint8_t new_depth = depth - 1;
+    if (gives_check && rel_ply < 2 * root_depth) new_depth++;
+
+    // Principal variation search: the first move gets the full window, the rest a null
+    // window proving they are no better, and a full re-search if the proof fails
+    if (legal_moves == 1) {
+      score = -negamax(pos, new_depth, -beta, -alpha);
+    } else {
 
-    score = -negamax(pos, depth - 1, -beta, -alpha);
+      // Late move reductions for quiet moves that don't give check
+      int32_t reduction = 0;
+      if (depth >= LMR_MIN_DEPTH && legal_moves > LMR_MIN_MOVES && is_quiet && !in_check && !gives_check) {
+        reduction = REDUCTIONS[std::min<int>(depth, 63)][std::min<int>(legal_moves, 63)];
+        if (pv_node) reduction--;
+        if (is_killer) reduction--;
+        reduction -= std::min(history_score / LMR_HISTORY_DIVISOR, 2);
+        reduction = std::clamp(reduction, 0, depth - 2);
+      }
+
+      score = -negamax(pos, new_depth - reduction, -alpha - 1, -alpha);
+      if (score > alpha && reduction > 0) {
+        score = -negamax(pos, new_depth, -alpha - 1, -alpha);
+      }
+      if (score > alpha && score < beta) {
+        score = -negamax(pos, new_depth, -beta, -alpha);
+      }
+    }
     pos.unmake_move();
     rel_ply--;
 
-    if (score > best_score) best_score = score;
-    if (score > alpha) alpha = score;
+    if (stopped) return 0;
+
+    if (score > best_score) {
+      best_score = score;
+      best_move = move;
+    }
+    if (score > alpha) {
+      alpha = score;
+      update_pv(move);
+    }
 
     // Beta cutoff
     if (alpha >= beta) {
 
-      if (pos.piece_list[move.get_to_sq()] == NO_PIECE) {
-        uint8_t piece = pos.piece_list[move.get_from_sq()];
-        uint8_t to_sq = move.get_to_sq();
-
-        update_killers(rel_ply, move);
-        history_heuristic[piece][to_sq] += (depth * depth);
-      }
+      if (is_quiet) update_quiet_stats(pos, move, quiets_tried, quiets_searched, depth);
 
       break;
     }
   }
 
   if (legal_moves == 0) {
-    uint8_t current_king_sq = get_lsbit_index(pos.all_piece_bitboards[WHITE_KING + pos.side_to_move]);
-    if (move_gen.is_square_attacked(pos, current_king_sq, pos.side_to_move)) {
-      // CHECKMATE
-      return -MATE_SCORE - depth;
+    if (in_check) {
+      // CHECKMATE, shorter mates score higher
+      return -MATE_SCORE + rel_ply;
     } else {
       return 0;
     }
   }
 
+  uint8_t bound = BOUND_EXACT;
+  if (best_score <= original_alpha) {
+    bound = BOUND_UPPER;
+  } else if (best_score >= beta) {
+    bound = BOUND_LOWER;
+  }
+  TT.store(pos.zobrist_key, score_to_tt(best_score), best_move, depth, bound);
+
   return best_score;
 }
 
-Move Search::negamax_root(Position& pos, uint8_t depth) {
+// Captures only, unless in check where every evasion is searched
+int32_t Search::quiescence(Position& pos, int32_t alpha, int32_t beta) {
+  pv_length[rel_ply] = rel_ply;
 
-  int32_t best_score = -INF;
-  Move best_move;
-  int32_t score = 0;
-  int32_t alpha = -INF;
-  int32_t beta = INF;
+  if ((count_node() & (CHECK_INTERVAL - 1)) == 0) check_limits();
+  if (stopped) return 0;
 
-  rel_ply = 0;
-  clear_history();
-  clear_killers();
+  if (rel_ply >= MAX_PLY - 1) return evaluate(pos);
 
-  MoveGenerator move_gen;
-  move_gen.generate(pos, killer_heuristic[rel_ply], history_heuristic);
-  uint8_t legal_moves = 0;
+  // Mostly captures from here on, so material is the draw worth checking
+  if (pos.has_insufficient_material()) return 0;
+
+  MoveGenerator move_gen(stack[rel_ply].moves.data(), &stack[rel_ply].attack_info);
+  bool in_check = stack[rel_ply].in_check;
+
+  int32_t best_score = -INF;
+  int32_t stand_pat = 0;
+
+  // Stand pat, the side to move can usually do at least as well as the static eval by not capturing
+  if (!in_check) {
+    stand_pat = evaluate(pos);
+    if (stand_pat >= beta) return stand_pat;
+    if (stand_pat > alpha) alpha = stand_pat;
+    best_score = stand_pat;
+  }
+
+  // Captures and queen promotions only, or every evasion when in check
+  std::array<Move, 2> no_killers = {Move(), Move()};
+  move_gen.count = 0;
+  move_gen.set_ordering(no_killers, quiet_history());
+  if (in_check) {
+    move_gen.append<EVASIONS>(pos);
+  } else {
+    move_gen.append<CAPTURES>(pos);
+  }
 
+  ScoredMove* moves = move_gen.moves;
   for (int i = 0; i < move_gen.count; i++) {
 
     uint8_t best_idx = i;
     for (uint8_t j = i + 1; j < move_gen.count; j++) {
-      if (move_gen.score_list[j] > move_gen.score_list[best_idx]) best_idx = j;
+      if (moves[j].score > moves[best_idx].score) best_idx = j;
+    }
+    std::swap(moves[i], moves[best_idx]);
+
+    Move move = moves[i].move;
+    uint8_t flags = move.get_flags();
+    uint8_t captured_piece_type = pos.piece_list[move.get_to_sq()];
+
+    if (!in_check) {
+      // Captures losing material by SEE are scored below zero and sorted last, none are worth a look
+      if (moves[i].score < 0) break;
+
+      if (flags == EN_PASSANT) captured_piece_type = WHITE_PAWN;
+      if (flags >= PROMO_KNIGHT && flags <= PROMO_ROOK) continue;
+
+      // Delta pruning
+      if (flags != PROMO_QUEEN && stand_pat + PIECE_VALUES[captured_piece_type] + DELTA_MARGIN <= alpha) continue;
     }
-    std::swap(move_gen.move_list[i], move_gen.move_list[best_idx]);
-    std::swap(move_gen.score_list[i], move_gen.score_list[best_idx]);
 
-    pos.make_move(move_gen.move_list[i]);
+    set_current_move(move, pos.piece_list[move.get_from_sq()]);
+    pos.make_move(move);
     rel_ply++;
-    uint8_t king_square = get_lsbit_index(pos.all_piece_bitboards[BLACK_KING - pos.side_to_move]);
+    start_ply(pos);
+    stack[rel_ply].in_check = side_to_move_in_check(pos);
 
-    if (move_gen.is_square_attacked(pos, king_square, pos.side_to_move^1)) {
-      pos.unmake_move();
-      rel_ply--;
-      continue;
+    int32_t score = -quiescence(pos, -beta, -alpha);
+    pos.unmake_move();
+    rel_ply--;
+
+    if (stopped) return 0;
+
+    if (score > best_score) best_score = score;
+    if (score > alpha) {
+      alpha = score;
+      update_pv(move);
     }
+    if (alpha >= beta) break;
+  }
 
-    legal_moves++;
+  // No evasions
+  if (in_check && move_gen.count == 0) return -MATE_SCORE + rel_ply;
+
+  return best_score;
+}
+
+// Searches the root moves from pv_index on to depth, in the order left by the previous search.
+// The moves before pv_index already are the best lines of this iteration.
+int32_t Search::search_root(Position& pos, uint8_t depth, int32_t alpha, int32_t beta, size_t pv_index) {
+
+  int32_t best_score = -INF;
+  Move best_move;
+  int32_t original_alpha = alpha;
+  bool first_move = true;
+
+  pv_length[0] = 0;
+  count_node();
+  root_depth = depth;
+
+  for (size_t i = pv_index; i < root_moves.size(); i++) {
+    root_moves[i].score = -INF;
+  }
+
+  for (size_t i = pv_index; i < root_moves.size(); i++) {
+    RootMove& root_move = root_moves[i];
+
+    uint64_t nodes_before = nodes.load(std::memory_order_relaxed);
+
+    set_current_move(root_move.move, pos.piece_list[root_move.move.get_from_sq()]);
+    pos.make_move(root_move.move);
+    TT.prefetch(pos.zobrist_key);
+    rel_ply++;
+    start_ply(pos);
+
+    bool gives_check = side_to_move_in_check(pos);
+    stack[rel_ply].in_check = gives_check;
+    uint8_t new_depth = gives_check ? depth : depth - 1;
+
+    int32_t score;
+    if (first_move) {
+      score = -negamax(pos, new_depth, -beta, -alpha);
+      first_move = false;
+    } else {
+      score = -negamax(pos, new_depth, -alpha - 1, -alpha);
+      if (score > alpha && score < beta) {
+        score = -negamax(pos, new_depth, -beta, -alpha);
+      }
+    }
+
+    pos.unmake_move();
+    rel_ply--;
+
+    if (stopped) return 0;
+
+    root_move.score = score;
+    root_move.nodes = nodes.load(std::memory_order_relaxed) - nodes_before;
 
-    score = -negamax(pos, depth - 1, -beta, -alpha);
     if (score > best_score) {
       best_score = score;
-      best_move = move_gen.move_list[i];
+      best_move = root_move.move;
     }
 
-    if (best_score > alpha) {
-      alpha = best_score;
+    if (score > alpha) {
+      alpha = score;
+      update_pv(root_move.move);
+      root_move.pv.assign(pv_table[0].begin(), pv_table[0].begin() + pv_length[0]);
     }
 
+    // Fail high, the aspiration loop re-searches with a wider window
+    if (alpha >= beta) break;
+  }
 
-    pos.unmake_move();
-    rel_ply--;
+  uint8_t bound = BOUND_EXACT;
+  if (best_score <= original_alpha) {
+    bound = BOUND_UPPER;
+  } else if (best_score >= beta) {
+    bound = BOUND_LOWER;
   }
+  // Later MultiPV lines leave out the best moves, their result doesn't belong in the table
+  if (pv_index == 0) TT.store(pos.zobrist_key, score_to_tt(best_score), best_move, depth, bound);
 
-  if (legal_moves == 0) {
-    uint8_t current_king_sq = get_lsbit_index(pos.all_piece_bitboards[WHITE_KING + pos.side_to_move]);
-    if (move_gen.is_square_attacked(pos, current_king_sq, pos.side_to_move)) {
-      // CHECKMATE
-      std::cout << "Mated" << std::endl;
-    } else {
-      // STALEMATE
-      std::cout << "Stalemate" << std::endl;
+  return best_score;
+}
+
+bool Search::is_draw(const Position& pos) {
+  if (pos.is_repetition() || pos.has_insufficient_material()) return true;
+
+  // Checkmate on the hundredth half move still wins
+  if (pos.halfmove_clock >= 100) {
+    if (!stack[rel_ply].in_check) return true;
+    // The node hasn't generated anything yet, its slice of the stack is free
+    MoveGenerator evasions(stack[rel_ply].moves.data(), &stack[rel_ply].attack_info);
+    evasions.generate(pos);
+    return evasions.count > 0;
+  }
+  return false;
+}
+
+int32_t Search::evaluate(const Position& pos) {
+  int32_t eval;
+  if (eval_cache.probe(pos.zobrist_key, eval)) return eval;
+
+  if (NNUE::is_active()) {
+    // Skipped on a hit, the plies below bring theirs up to date from further up
+    update_accumulator(pos, WHITE);
+    update_accumulator(pos, BLACK);
+    eval = NNUE::evaluate(pos, stack[rel_ply].accumulator);
+  } else {
+    eval = Evaluation::evaluate_position(pos, pawn_table);
+  }
+
+  eval_cache.store(pos.zobrist_key, eval);
+  return eval;
+}
+
+void Search::update_accumulator(const Position& pos, uint8_t perspective) {
+  if (stack[rel_ply].accumulator.computed[perspective]) return;
+
+  // Walk up to a computed accumulator, unless a move of this side's king is in the way
+  int32_t ply = rel_ply;
+  while (ply > 0 && !stack[ply].accumulator.computed[perspective]) {
+    const DirtyPiece& dirty = stack[ply].accumulator.dirty;
+    if (dirty.count && dirty.piece[0] == WHITE_KING + perspective) break;
+    ply--;
+  }
+
+  if (!stack[ply].accumulator.computed[perspective]) {
+    NNUE::refresh(pos, stack[rel_ply].accumulator, perspective);
+    return;
+  }
+
+  uint8_t king_sq = get_lsbit_index(pos.all_piece_bitboards[WHITE_KING + perspective]);
+  for (ply++; ply <= rel_ply; ply++) {
+    NNUE::update(stack[ply - 1].accumulator, stack[ply].accumulator, perspective, king_sq);
+  }
+}
+
+void Search::update_quiet_stats(const Position& pos, Move best_move,
+                                const std::array<Move, MAX_QUIETS_TRIED>& quiets_tried,
+                                uint8_t quiet_count, uint8_t depth) {
+  int32_t bonus = std::min(16 * depth * depth + 32 * depth, HISTORY_BONUS_MAX);
+
+  update_quiet_history(pos, best_move, bonus);
+  for (uint8_t i = 0; i < quiet_count; i++) {
+    if (!(quiets_tried[i] == best_move)) update_quiet_history(pos, quiets_tried[i], -bonus);
+  }
+
+  update_killers(rel_ply, best_move);
+  if (continuation_table(1)) counter_moves[stack[rel_ply - 1].moved_piece][stack[rel_ply - 1].current_move.get_to_sq()] = best_move;
+}
+
+void Search::update_quiet_history(const Position& pos, Move move, int32_t bonus) {
+  uint8_t from_sq = move.get_from_sq();
+  uint8_t to_sq = move.get_to_sq();
+  uint8_t piece = pos.piece_list[from_sq];
+
+  apply_gravity(butterfly_history[pos.side_to_move][from_sq][to_sq], bonus);
+  for (int32_t plies_back = 1; plies_back <= 2; plies_back++) {
+    PieceToHistory* table = continuation_table(plies_back);
+    if (table) apply_gravity((*table)[piece][to_sq], bonus);
+  }
+}
+
+// Same sum MoveGenerator::add_move orders quiets by
+int32_t Search::quiet_history_score(const Position& pos, Move move) {
+  uint8_t from_sq = move.get_from_sq();
+  uint8_t to_sq = move.get_to_sq();
+  uint8_t piece = pos.piece_list[from_sq];
+
+  int32_t score = butterfly_history[pos.side_to_move][from_sq][to_sq];
+  for (int32_t plies_back = 1; plies_back <= 2; plies_back++) {
+    const PieceToHistory* table = continuation_table(plies_back);
+    if (table) score += (*table)[piece][to_sq];
+  }
+  return score;
+}
+
+QuietHistory Search::quiet_history() {
+  QuietHistory history;
+  history.butterfly = &butterfly_history;
+  history.continuation = {continuation_table(1), continuation_table(2)};
+  if (history.continuation[0]) history.counter_move = counter_moves[stack[rel_ply - 1].moved_piece][stack[rel_ply - 1].current_move.get_to_sq()];
+  return history;
+}
+
+void Search::clear_history() {
+  for (auto& from_table : butterfly_history) {
+    for (auto& to_table : from_table) to_table.fill(0);
+  }
+  for (auto& piece_tables : continuation_history) {
+    for (PieceToHistory& table : piece_tables) {
+      for (auto& to_table : table) to_table.fill(0);
+    }
+  }
+  for (auto& to_moves : counter_moves) to_moves.fill(Move());
+}
+
+// Best move first, then by score, with subtree size breaking the ties between fail lows
+void Search::sort_root_moves(size_t begin, Move best_move) {
+  std::stable_sort(root_moves.begin() + begin, root_moves.end(), [best_move](const RootMove& a, const RootMove& b) {
+    if (a.move == best_move) return !(b.move == best_move);
+    if (b.move == best_move) return false;
+    if (a.score != b.score) return a.score > b.score;
+    return a.nodes > b.nodes;
+  });
+}
+
+void Search::check_limits() {
+  if (stop_signal && stop_signal->load(std::memory_order_relaxed)) stopped = true;
+
+  if (ponder_signal && ponder_signal->load(std::memory_order_relaxed)) {
+    start_time = std::chrono::steady_clock::now();
+    return;
+  }
+
+  if (limits.nodes) {
+    uint64_t searched = total_nodes ? total_nodes() : nodes.load(std::memory_order_relaxed);
+    if (searched >= limits.nodes) stopped = true;
+  }
+
+  if (limits.movetime_ms) {
+    auto elapsed = std::chrono::steady_clock::now() - start_time;
+    if ((uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() >= limits.movetime_ms) {
+      stopped = true;
     }
   }
+}
+
+Move Search::negamax_root(Position& pos, uint8_t depth) {
+  SearchLimits depth_limit;
+  depth_limit.depth = depth;
+  return negamax_root(pos, depth_limit);
+}
+
+Move Search::negamax_root(Position& pos, const SearchLimits& search_limits) {
+
+  limits = search_limits;
+  start_time = std::chrono::steady_clock::now();
+  stopped = false;
+  nodes.store(0, std::memory_order_relaxed);
+  eval_cache.reset_stats();
+  best_score = 0;
+  completed_depth = 0;
+  principal_variation.clear();
+  lines.clear();
+
+  rel_ply = 0;
+  clear_killers();
+  stack[0].in_check = side_to_move_in_check(pos);
+  stack[0].accumulator.computed = {false, false};
+  stack[0].attack_info.valid = false;
+
+  Move tt_move;
+  TTEntry tt_entry;
+  if (TT.probe(pos.zobrist_key, tt_entry)) tt_move = tt_entry.move;
+
+  // Initial root order is the staged order, later iterations re-sort by score
+  MovePicker move_picker(pos, tt_move, stack[0].killers, quiet_history(), stack[0].moves.data(),
+                         stack[0].attack_info);
+  root_moves.clear();
+
+  Move move;
+  while ((move = move_picker.next_move()).move_data != 0) {
+    RootMove root_move;
+    root_move.move = move;
+    root_move.score = -INF;
+    root_moves.push_back(root_move);
+  }
+
+  // Checkmate or stalemate, the caller tells them apart
+  if (root_moves.empty()) return Move();
+
+  // Something sensible to return even if the first iteration is cut off
+  Move best_move = root_moves[0].move;
+  principal_variation.push_back(best_move);
+
+  uint8_t max_depth = (limits.depth && limits.depth < MAX_PLY) ? limits.depth : MAX_PLY - 1;
+  size_t multi_pv = std::min<size_t>(std::max<uint8_t>(limits.multi_pv, 1), root_moves.size());
+
+  for (uint8_t depth = 1; depth <= max_depth; depth++) {
+
+    // Helpers skip some depths so the threads spread over different iterations
+    if (thread_id != 0) {
+      size_t i = (thread_id - 1) % SKIP_SIZE.size();
+      if (((depth + SKIP_PHASE[i]) / SKIP_SIZE[i]) % 2) continue;
+    }
+
+    for (RootMove& root_move : root_moves) {
+      root_move.previous_score = root_move.score;
+    }
+
+    // Each MultiPV line searches the moves the earlier lines didn't take, sharing
+    // the transposition table and move ordering statistics with them
+    for (size_t pv_index = 0; pv_index < multi_pv && !stopped; pv_index++) {
+
+      // Aspiration window around the line's previous score, widened on every failure
+      int32_t previous_score = root_moves[pv_index].previous_score;
+      int32_t delta = ASPIRATION_WINDOW;
+      int32_t alpha = -INF;
+      int32_t beta = INF;
+      if (completed_depth >= ASPIRATION_MIN_DEPTH && std::abs(previous_score) < MATE_BOUND) {
+        alpha = std::max(previous_score - delta, -INF);
+        beta = std::min(previous_score + delta, INF);
+      }
+
+      while (true) {
+        int32_t score = search_root(pos, depth, alpha, beta, pv_index);
+        if (stopped) break;
+
+        if (score <= alpha) {
+          beta = (alpha + beta) / 2;
+          alpha = std::max(score - delta, -INF);
+        } else if (score >= beta) {
+          beta = std::min(score + delta, INF);
+          // Fail high move goes first in the re-search
+          sort_root_moves(pv_index, pv_table[0][0]);
+        } else {
+          break;
+        }
+
+        delta += delta / 2;
+      }
+
+      if (!stopped) sort_root_moves(pv_index, pv_table[0][0]);
+    }
+
+    // Results of an unfinished iteration are discarded
+    if (stopped) break;
+
+    // A later line can come out above an earlier one through search instability
+    std::stable_sort(root_moves.begin(), root_moves.begin() + multi_pv, [](const RootMove& a, const RootMove& b) {
+      return a.score > b.score;
+    });
+
+    best_move = root_moves[0].move;
+    best_score = root_moves[0].score;
+    completed_depth = depth;
+    principal_variation = root_moves[0].pv;
+
+    lines.clear();
+    for (size_t i = 0; i < multi_pv; i++) {
+      lines.push_back({root_moves[i].move, root_moves[i].score, depth, root_moves[i].pv, root_moves[i].nodes});
+    }
+
+    if (thread_id == 0 && on_iteration) on_iteration(*this);
+  }
 
   return best_move;
 
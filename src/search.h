@@ -1,49 +1,295 @@
 #pragma once
 #include <cstdint>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <vector>
 #include "position.h"
 #include "move.h"
+#include "attack_info.h"
+#include "eval_cache.h"
+#include "nnue.h"
+#include "pawns.h"
 
-using PST = std::array<std::array<int32_t, 64>, 12>;
+constexpr int32_t MAX_PLY = 128;
+
+// Quiet move statistics stay within +-HISTORY_MAX thanks to the gravity update
+constexpr int32_t HISTORY_MAX = 16384;
+// [side][from_sq][to_sq]
+using ButterflyHistory = std::array<std::array<std::array<int16_t, 64>, 64>, 2>;
+// [piece_type][to_sq]
+using PieceToHistory = std::array<std::array<int16_t, 64>, 12>;
+// [piece_type][to_sq] of an earlier move, then the PieceToHistory of the replies to it
+using ContinuationHistory = std::array<std::array<PieceToHistory, 64>, 12>;
+
+// What MoveGenerator::add_move combines into the score of a quiet move
+struct QuietHistory {
+  const ButterflyHistory* butterfly = nullptr;
+  // Continuation tables of the moves 1 and 2 plies back, null where there is no such move
+  std::array<const PieceToHistory*, 2> continuation = {nullptr, nullptr};
+  // Quiet move that last refuted the opponent's previous move
+  Move counter_move;
+};
+
+// What a node keeps about its own ply. Each thread's Search owns one entry per ply, so nodes reuse
+// them instead of putting a fresh move list on the call stack, and no two entries share a cache line.
+struct alignas(64) SearchStack {
+  // Whether the side to move is in check, filled in by the parent node after making the move
+  bool in_check = false;
+  // Piece type of the move made at this ply, NO_PIECE for a null move
+  uint8_t moved_piece = NO_PIECE;
+  Move current_move;
+  std::array<Move, 2> killers;
+  int32_t static_eval = 0;
+  // Moves and ordering scores generated at this ply
+  std::array<ScoredMove, MAX_MOVES> moves;
+  // Only computed when the NNUE evaluates a node at this ply
+  NNUE::Accumulator accumulator;
+  // Computed when the node first needs it, usually for move generation
+  AttackInfo attack_info;
+};
+
+// A depth of 0 or a limit of 0 means no limit of that kind
+struct SearchLimits {
+  uint8_t depth = 0;
+  uint64_t movetime_ms = 0;
+  // Nodes of every thread together
+  uint64_t nodes = 0;
+  // Number of best root moves to get exact scores and PVs for
+  uint8_t multi_pv = 1;
+};
+
+// Pruning margins in centipawns, kept out of the code so they can be tuned without a rebuild.
+// Each one is a UCI spin option of the same name, see UCI::set_option.
+struct SearchParams {
+  // Reverse futility: static eval - margin * depth >= beta
+  int32_t reverse_futility_margin = 80;
+  int32_t reverse_futility_max_depth = 6;
+  // Futility: static eval + base + margin * depth <= alpha prunes quiet moves
+  int32_t futility_base = 100;
+  int32_t futility_margin = 90;
+  int32_t futility_max_depth = 3;
+  // Razoring: static eval + margin * depth < alpha goes to quiescence
+  int32_t razor_margin = 250;
+  int32_t razor_max_depth = 2;
+};
+
+extern SearchParams Params;
+
+struct RootMove {
+  Move move;
+  // Score from the last search of this move, used to order the next one
+  int32_t score = 0;
+  // Score at the start of the current iteration, centers the aspiration window of its line
+  int32_t previous_score = 0;
+  // Nodes spent below this move in the last completed iteration
+  uint64_t nodes = 0;
+  // Only kept up to date for moves that were the best of a MultiPV line
+  std::vector<Move> pv;
+};
+
+// One of the MultiPV lines, best line first
+struct PVLine {
+  Move move;
+  int32_t score;
+  uint8_t depth;
+  std::vector<Move> pv;
+  uint64_t nodes;
+};
 
 class Search {
 
 public:
 
+  // Iterative deepening up to depth
   Move negamax_root(Position& pos, uint8_t depth);
+  Move negamax_root(Position& pos, const SearchLimits& limits);
+
+  // Results of the last completed iteration
+  int32_t best_score = 0;
+  uint8_t completed_depth = 0;
+  std::vector<Move> principal_variation;
+  // Every MultiPV line of that iteration, lines[0] matches the fields above
+  std::vector<PVLine> lines;
+
+  // Only written by the owning thread, on its own cache line so
+  // other threads polling it don't slow down the searching thread
+  alignas(64) std::atomic<uint64_t> nodes{0};
+
+  // Quiet move statistics survive between searches, this forgets them for a new game
+  void clear_history();
+
+  // Needed whenever the evaluation changes, the cached scores came from the old one
+  void clear_eval_cache() { eval_cache.clear(); }
+  // Pawn entries stay valid across searches, this is only for a new game
+  void clear_pawn_table() { pawn_table.clear(); }
+  // Hits and misses are counted from the start of the last search
+  const EvalCache& evaluation_cache() const { return eval_cache; }
+
+  // 0 is the main thread, helpers skip depths according to their id
+  size_t thread_id = 0;
+  // Set by the thread pool to stop every thread at once
+  const std::atomic<bool>* stop_signal = nullptr;
+  // Set by the thread pool while pondering, the clock doesn't run until it clears
+  const std::atomic<bool>* ponder_signal = nullptr;
+  // Called by the main thread after every completed iteration
+  std::function<void(const Search&)> on_iteration;
+  // Set by the thread pool on the main thread, nodes of every thread for the node limit
+  std::function<uint64_t()> total_nodes;
+
+  // Full moves to mate for a mate score, negative when being mated, 0 for any other score
+  static inline int32_t mate_in(int32_t score) {
+    if (score >= MATE_BOUND) return (MATE_SCORE - score + 1) / 2;
+    if (score <= -MATE_BOUND) return -(MATE_SCORE + score) / 2;
+    return 0;
+  }
 
 private:
 
-  // [piece_type][to_sq]
-  std::array<std::array<int32_t, 64>, 12> history_heuristic = {0};
-  // [ply][move]
-  std::array<std::array<Move, 2>, 256> killer_heuristic = {Move()};
+  ButterflyHistory butterfly_history = {};
+  ContinuationHistory continuation_history = {};
+  // [piece_type][to_sq] of the opponent's move
+  std::array<std::array<Move, 64>, 12> counter_moves = {};
+
+  // Triangular principal variation table, [ply][ply..pv_length[ply]]
+  std::array<std::array<Move, MAX_PLY>, MAX_PLY> pv_table;
+  std::array<uint8_t, MAX_PLY> pv_length;
+
+  std::vector<RootMove> root_moves;
+  uint8_t root_depth = 0;
+
+  // [ply]
+  std::array<SearchStack, MAX_PLY + 1> stack;
+  // Pawn structure cache of this thread
+  PawnTable pawn_table;
+  EvalCache eval_cache;
+
+  SearchLimits limits;
+  std::chrono::steady_clock::time_point start_time;
+  bool stopped = false;
 
-  const int32_t MATE_SCORE = 50'000;
+  static constexpr int32_t MATE_SCORE = 50'000;
   const int32_t INF = 60000;
+  // Scores beyond this are mates, stored in the transposition table relative to the node
+  static constexpr int32_t MATE_BOUND = MATE_SCORE - 256;
+  // Nodes between checks of the time and node limits
+  static const uint64_t CHECK_INTERVAL = 2048;
+  // Half width of the first aspiration window, grows by half on every fail
+  static const int32_t ASPIRATION_WINDOW = 25;
+  static const uint8_t ASPIRATION_MIN_DEPTH = 4;
+  static const uint8_t NULL_MOVE_MIN_DEPTH = 3;
+  static const uint8_t LMR_MIN_DEPTH = 3;
+  // Moves searched at full depth before reductions start
+  static const uint8_t LMR_MIN_MOVES = 3;
+  // Combined history score worth one ply less reduction
+  static const int32_t LMR_HISTORY_DIVISOR = 8192;
+  // Largest history bonus, reached around depth 8
+  static constexpr int32_t HISTORY_BONUS_MAX = 1200;
+  // Quiets remembered per node for the history malus
+  static const uint8_t MAX_QUIETS_TRIED = 64;
+  // Quiet moves searched before the rest are pruned is LMP_BASE + depth * depth
+  static const uint8_t LMP_MAX_DEPTH = 3;
+  static const uint8_t LMP_BASE = 3;
+  // A capture that can't lift the stand pat score to within this of alpha is skipped
+  static const int32_t DELTA_MARGIN = 200;
+  // [piece_type], only used for delta pruning
+  static constexpr std::array<int32_t, 12> PIECE_VALUES = {100, 100, 320, 320, 330, 330, 500, 500, 900, 900, 0, 0};
+
+  // Lazy SMP depth skipping pattern for helper threads
+  static constexpr std::array<uint8_t, 20> SKIP_SIZE = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+  static constexpr std::array<uint8_t, 20> SKIP_PHASE = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
 
   int32_t rel_ply = 0;
 
+  int32_t search_root(Position& pos, uint8_t depth, int32_t alpha, int32_t beta, size_t pv_index);
+  void sort_root_moves(size_t begin, Move best_move);
   int32_t negamax(Position& pos, uint8_t depth, int32_t alpha, int32_t beta);
+  int32_t quiescence(Position& pos, int32_t alpha, int32_t beta);
+
+  // Repetition, insufficient material or the fifty-move rule, checked everywhere but the root
+  bool is_draw(const Position& pos);
+
+  // Static evaluation for the side to move, from the NNUE when one is in use
+  int32_t evaluate(const Position& pos);
+  // Brings the current ply's accumulator up to date for perspective, from the nearest ply
+  // above that has one, or from scratch after that side's king moved
+  void update_accumulator(const Position& pos, uint8_t perspective);
+
+  // Rewards the quiet move that failed high and penalizes the quiets searched before it
+  void update_quiet_stats(const Position& pos, Move best_move, const std::array<Move, MAX_QUIETS_TRIED>& quiets_tried,
+                          uint8_t quiet_count, uint8_t depth);
+  void update_quiet_history(const Position& pos, Move move, int32_t bonus);
+  int32_t quiet_history_score(const Position& pos, Move move);
+  QuietHistory quiet_history();
+
+  void check_limits();
+
+  inline bool has_non_pawn_material(const Position& pos, uint8_t side) const {
+    return (pos.all_piece_bitboards[WHITE_KNIGHT + side] | pos.all_piece_bitboards[WHITE_BISHOP + side] |
+            pos.all_piece_bitboards[WHITE_ROOK + side] | pos.all_piece_bitboards[WHITE_QUEEN + side]) != 0;
+  }
+
+  // No other thread writes nodes, so a plain load and store is enough
+  inline uint64_t count_node() {
+    uint64_t count = nodes.load(std::memory_order_relaxed) + 1;
+    nodes.store(count, std::memory_order_relaxed);
+    return count;
+  }
+
+  inline void update_pv(Move move) {
+    pv_table[rel_ply][rel_ply] = move;
+    for (uint8_t i = rel_ply + 1; i < pv_length[rel_ply + 1]; i++) {
+      pv_table[rel_ply][i] = pv_table[rel_ply + 1][i];
+    }
+    pv_length[rel_ply] = pv_length[rel_ply + 1];
+  }
+
+  inline int32_t score_to_tt(int32_t score) const {
+    if (score >= MATE_BOUND) return score + rel_ply;
+    if (score <= -MATE_BOUND) return score - rel_ply;
+    return score;
+  }
+
+  inline int32_t score_from_tt(int32_t score) const {
+    if (score >= MATE_BOUND) return score - rel_ply;
+    if (score <= -MATE_BOUND) return score + rel_ply;
+    return score;
+  }
 
   inline void update_killers(uint8_t ply, Move move) {
-    killer_heuristic[ply][1] = killer_heuristic[ply][0];
-    killer_heuristic[ply][0] = move;
+    stack[ply].killers[1] = stack[ply].killers[0];
+    stack[ply].killers[0] = move;
   }
 
   inline void clear_killers() {
-    for (int i = 0; i < 256; i++) {
-      killer_heuristic[i][0] = Move();
-      killer_heuristic[i][1] = Move();
-    }
+    for (SearchStack& entry : stack) entry.killers = {Move(), Move()};
   }
 
-  inline void clear_history() {
-    for (int i = 0; i < 12; i++) {
-      for (int j = 0; j < 64; j++) {
-        history_heuristic[i][j] = 0;
-      }
-    }
+  // Remembers the move about to be made at the current ply, Move() and NO_PIECE for a null move
+  inline void set_current_move(Move move, uint8_t piece) {
+    stack[rel_ply].current_move = move;
+    stack[rel_ply].moved_piece = piece;
+  }
+
+  // Called once a move is made and rel_ply advanced, invalidates what the ply kept about its last position
+  inline void start_ply(const Position& pos) {
+    stack[rel_ply].accumulator.dirty = pos.dirty_piece;
+    stack[rel_ply].accumulator.computed = {false, false};
+    stack[rel_ply].attack_info.valid = false;
+  }
+
+  // Continuation table of the move made plies_back before the current node, null if there is none
+  inline PieceToHistory* continuation_table(int32_t plies_back) {
+    int32_t ply = rel_ply - plies_back;
+    if (ply < 0 || stack[ply].moved_piece == NO_PIECE) return nullptr;
+    return &continuation_history[stack[ply].moved_piece][stack[ply].current_move.get_to_sq()];
+  }
+
+  // Moves entry towards the bonus, the closer it already is to HISTORY_MAX the smaller the step
+  static inline void apply_gravity(int16_t& entry, int32_t bonus) {
+    entry += bonus - entry * std::abs(bonus) / HISTORY_MAX;
   }
 
 };
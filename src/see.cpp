@@ -0,0 +1,87 @@
+#include "see.h"
+#include "move.h"
+#include "move_generator.h"
+#include "move_utility.h"
+#include "piece.h"
+#include "position.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+using namespace MoveUtility;
+
+namespace SEE {
+
+int32_t evaluate(const Position& pos, Move move) {
+  uint8_t from_sq = move.get_from_sq();
+  uint8_t to_sq = move.get_to_sq();
+  uint8_t flags = move.get_flags();
+
+  if (flags == CASTLE_KINGSIDE || flags == CASTLE_QUEENSIDE) return 0;
+
+  // gain[d]: what the side making capture d wins if the exchange stops right after it
+  std::array<int32_t, 32> gain;
+  uint64_t occupancy = pos.total_bb ^ (1ULL << from_sq);
+  uint8_t on_square = pos.piece_list[from_sq] >> 1;
+
+  if (flags == EN_PASSANT) {
+    gain[0] = PIECE_VALUES[PAWN];
+    occupancy ^= 1ULL << (pos.side_to_move == WHITE ? to_sq - 8 : to_sq + 8);
+  } else {
+    uint8_t captured = pos.piece_list[to_sq];
+    gain[0] = (captured == NO_PIECE) ? 0 : PIECE_VALUES[captured >> 1];
+  }
+
+  if (flags >= PROMO_KNIGHT && flags <= PROMO_QUEEN) {
+    on_square = flags;  // PROMO_KNIGHT..PROMO_QUEEN line up with KNIGHT..QUEEN
+    gain[0] += PIECE_VALUES[on_square] - PIECE_VALUES[PAWN];
+  }
+
+  uint64_t bishops = pos.all_piece_bitboards[WHITE_BISHOP] | pos.all_piece_bitboards[BLACK_BISHOP] |
+                     pos.all_piece_bitboards[WHITE_QUEEN] | pos.all_piece_bitboards[BLACK_QUEEN];
+  uint64_t rooks = pos.all_piece_bitboards[WHITE_ROOK] | pos.all_piece_bitboards[BLACK_ROOK] |
+                   pos.all_piece_bitboards[WHITE_QUEEN] | pos.all_piece_bitboards[BLACK_QUEEN];
+
+  uint64_t attackers = MoveGenerator::attackers_to(pos, to_sq, occupancy) & occupancy;
+  uint8_t side = pos.side_to_move ^ 1;
+  int depth = 0;
+
+  while (depth < 31) {
+    uint64_t side_attackers = attackers & pos.occupancy_bitboards[side];
+    if (!side_attackers) break;
+
+    // Least valuable attacker
+    uint8_t piece = PAWN;
+    uint64_t piece_bb = 0;
+    for (; piece <= KING; piece++) {
+      piece_bb = side_attackers & pos.all_piece_bitboards[2 * piece + side];
+      if (piece_bb) break;
+    }
+
+    // The king can only recapture when nothing defends the square anymore
+    if (piece == KING && (attackers & pos.occupancy_bitboards[side ^ 1])) break;
+
+    depth++;
+    gain[depth] = PIECE_VALUES[on_square] - gain[depth - 1];
+
+    occupancy ^= 1ULL << get_lsbit_index(piece_bb);
+
+    // X-rays: sliders lined up behind the piece that just captured join in
+    if (piece == PAWN || piece == BISHOP || piece == QUEEN) attackers |= get_bishop_attacks(to_sq, occupancy) & bishops;
+    if (piece == ROOK || piece == QUEEN) attackers |= get_rook_attacks(to_sq, occupancy) & rooks;
+    attackers &= occupancy;
+
+    on_square = piece;
+    side ^= 1;
+  }
+
+  // Walk back up, each side picking the better of capturing or stopping
+  while (depth > 0) {
+    gain[depth - 1] = -std::max(-gain[depth - 1], gain[depth]);
+    depth--;
+  }
+
+  return gain[0];
+}
+
+} // namespace SEE
@@ -0,0 +1,17 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include "move.h"
+#include "position.h"
+
+namespace SEE {
+
+// [piece] (PAWN..KING)
+constexpr std::array<int32_t, 6> PIECE_VALUES = {100, 320, 330, 500, 900, 20000};
+
+// Material won or lost by the side to move in the exchange move starts on its destination
+// square, both sides always recapturing with their least valuable attacker and either side
+// free to stop when going on would lose more. Pins are ignored.
+int32_t evaluate(const Position& pos, Move move);
+
+} // namespace SEE
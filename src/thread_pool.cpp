@@ -0,0 +1,191 @@
+#include "thread_pool.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "move.h"
+#include "position.h"
+#include "search.h"
+#include "transposition_table.h"
+
+ThreadPool Threads;
+
+ThreadPool::ThreadPool() {
+  set_threads(1);
+}
+
+ThreadPool::~ThreadPool() {
+  if (is_searching()) {
+    stop();
+    wait_for_search();
+  }
+  stop_helpers();
+}
+
+void ThreadPool::stop_helpers() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quit = true;
+  }
+  cv.notify_all();
+
+  for (std::unique_ptr<Worker>& worker : workers) {
+    if (worker->thread.joinable()) worker->thread.join();
+  }
+
+  quit = false;
+}
+
+void ThreadPool::set_threads(size_t count) {
+  if (count == 0) count = 1;
+
+  stop_helpers();
+  workers.clear();
+  best_index = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    workers.push_back(std::make_unique<Worker>());
+    Worker& worker = *workers.back();
+    worker.search.thread_id = i;
+    worker.search.stop_signal = &stop_signal;
+    worker.search.ponder_signal = &ponder_signal;
+    if (i == 0) {
+      worker.search.on_iteration = iteration_callback;
+      worker.search.total_nodes = [this] { return nodes_searched(); };
+    }
+
+    // The main worker runs on whichever thread calls search()
+    if (i != 0) worker.thread = std::thread(&ThreadPool::idle_loop, this, std::ref(worker));
+  }
+}
+
+void ThreadPool::set_iteration_callback(std::function<void(const Search&)> callback) {
+  iteration_callback = callback;
+  workers[0]->search.on_iteration = iteration_callback;
+}
+
+void ThreadPool::clear_history() {
+  for (std::unique_ptr<Worker>& worker : workers) worker->search.clear_history();
+}
+
+void ThreadPool::clear_eval_caches() {
+  for (std::unique_ptr<Worker>& worker : workers) worker->search.clear_eval_cache();
+}
+
+void ThreadPool::clear_pawn_tables() {
+  for (std::unique_ptr<Worker>& worker : workers) worker->search.clear_pawn_table();
+}
+
+void ThreadPool::idle_loop(Worker& worker) {
+  while (true) {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&] { return quit || worker.searching; });
+    if (quit) return;
+    SearchLimits limits = helper_limits;
+    lock.unlock();
+
+    worker.search.negamax_root(worker.pos, limits);
+
+    lock.lock();
+    worker.searching = false;
+    lock.unlock();
+    cv.notify_all();
+  }
+}
+
+Move ThreadPool::search(const Position& pos, const SearchLimits& limits) {
+  stop_signal.store(false, std::memory_order_relaxed);
+  ponder_signal.store(false, std::memory_order_relaxed);
+  return run_search(pos, limits);
+}
+
+void ThreadPool::start_search(const Position& pos, const SearchLimits& limits, bool ponder,
+                              std::function<void(Move)> on_done) {
+  // Reset here rather than on the search thread, so a stop sent right after can't be lost
+  stop_signal.store(false, std::memory_order_relaxed);
+  ponder_signal.store(ponder, std::memory_order_relaxed);
+  background_pos = pos;
+  background_limits = limits;
+  search_thread = std::thread([this, on_done] {
+    background_move = run_search(background_pos, background_limits);
+    if (on_done) on_done(background_move);
+  });
+}
+
+Move ThreadPool::wait_for_search() {
+  search_thread.join();
+  return background_move;
+}
+
+Move ThreadPool::run_search(const Position& pos, const SearchLimits& limits) {
+
+  TT.new_search();
+
+  // Helpers only obey the depth limit, the main thread stops them once it is done
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    helper_limits = SearchLimits();
+    helper_limits.depth = limits.depth;
+
+    // Before any thread starts, so the pool total never includes the last search's helpers
+    for (std::unique_ptr<Worker>& worker : workers) worker->search.nodes.store(0, std::memory_order_relaxed);
+
+    for (size_t i = 1; i < workers.size(); i++) {
+      workers[i]->pos = pos;
+      workers[i]->searching = true;
+    }
+  }
+  cv.notify_all();
+
+  Worker& main_worker = *workers[0];
+  main_worker.pos = pos;
+  Move best_move = main_worker.search.negamax_root(main_worker.pos, limits);
+
+  stop();
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&] {
+      for (size_t i = 1; i < workers.size(); i++) {
+        if (workers[i]->searching) return false;
+      }
+      return true;
+    });
+  }
+
+  // Prefer a helper only if it finished a deeper iteration, or the same one with a better score.
+  // Helpers search a single PV, so with MultiPV only the main thread has every line.
+  best_index = 0;
+  for (size_t i = 1; i < workers.size() && limits.multi_pv <= 1; i++) {
+    const Search& best = workers[best_index]->search;
+    const Search& candidate = workers[i]->search;
+    if (candidate.principal_variation.empty()) continue;
+
+    if (candidate.completed_depth > best.completed_depth ||
+        (candidate.completed_depth == best.completed_depth && candidate.best_score > best.best_score)) {
+      best_index = i;
+    }
+  }
+
+  if (best_index != 0) best_move = workers[best_index]->search.principal_variation[0];
+
+  return best_move;
+}
+
+void ThreadPool::eval_cache_stats(uint64_t& hits, uint64_t& misses) const {
+  hits = 0;
+  misses = 0;
+  for (const std::unique_ptr<Worker>& worker : workers) {
+    hits += worker->search.evaluation_cache().hits;
+    misses += worker->search.evaluation_cache().misses;
+  }
+}
+
+uint64_t ThreadPool::nodes_searched() const {
+  uint64_t total = 0;
+  for (const std::unique_ptr<Worker>& worker : workers) {
+    total += worker->search.nodes.load(std::memory_order_relaxed);
+  }
+  return total;
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "move.h"
+#include "position.h"
+#include "search.h"
+
+// Lazy SMP: every thread runs the same iterative deepening search on its own copy
+// of the position, sharing only the transposition table.
+class ThreadPool {
+
+public:
+
+  ThreadPool();
+  ~ThreadPool();
+
+  // Total number of searching threads, including the calling thread
+  void set_threads(size_t count);
+  size_t size() const { return workers.size(); }
+
+  // Forgets the quiet move statistics of every thread, for a new game
+  void clear_history();
+  // For a new game or after switching the evaluation
+  void clear_eval_caches();
+  // For a new game, pawn entries don't depend on the evaluation in use
+  void clear_pawn_tables();
+
+  // Searches on the calling thread with the helpers running in the background,
+  // returns once every thread has stopped
+  Move search(const Position& pos, const SearchLimits& limits);
+
+  // Can be called from any thread to end the current search early
+  void stop() { stop_signal.store(true, std::memory_order_relaxed); }
+
+  // Same search on a thread of its own, returns at once. on_done gets the best move, called from
+  // that thread once every thread has stopped. The previous background search must be waited for.
+  // A ponder search is on the position after the reply we expect: time and node limits are held
+  // off until ponder_hit, so the whole budget is left for after it.
+  void start_search(const Position& pos, const SearchLimits& limits, bool ponder = false,
+                    std::function<void(Move)> on_done = nullptr);
+  // Blocks until the background search has ended, returns its move
+  Move wait_for_search();
+  // True from start_search until wait_for_search, even once the search has ended
+  bool is_searching() const { return search_thread.joinable(); }
+
+  // The expected reply was played: the ponder search carries on under its limits
+  void ponder_hit() { ponder_signal.store(false, std::memory_order_relaxed); }
+  bool is_pondering() const { return ponder_signal.load(std::memory_order_relaxed); }
+
+  // Called by the main thread after every completed iteration, for progress output
+  void set_iteration_callback(std::function<void(const Search&)> callback);
+
+  // Thread whose result was picked by the last search
+  const Search& best_thread() const { return workers[best_index]->search; }
+  uint64_t nodes_searched() const;
+  // Evaluation cache probes of every thread in the last search
+  void eval_cache_stats(uint64_t& hits, uint64_t& misses) const;
+
+private:
+
+  struct Worker {
+    Search search;
+    Position pos;
+    bool searching = false;
+    std::thread thread;
+  };
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::atomic<bool> stop_signal{false};
+  size_t best_index = 0;
+
+  std::thread search_thread;
+  std::atomic<bool> ponder_signal{false};
+  Position background_pos;
+  SearchLimits background_limits;
+  Move background_move;
+  std::function<void(const Search&)> iteration_callback;
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  SearchLimits helper_limits;
+  bool quit = false;
+
+  void idle_loop(Worker& worker);
+  void stop_helpers();
+  Move run_search(const Position& pos, const SearchLimits& limits);
+
+};
+
+extern ThreadPool Threads;
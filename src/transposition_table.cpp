@@ -0,0 +1,98 @@
+#include "transposition_table.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "move.h"
+
+TranspositionTable TT;
+
+TranspositionTable::TranspositionTable(size_t size_mb) : bucket_mask(0), generation(0) {
+  resize(size_mb);
+}
+
+void TranspositionTable::resize(size_t size_mb) {
+  size_t bucket_count = (size_mb * 1024 * 1024) / sizeof(TTBucket);
+  if (bucket_count == 0) bucket_count = 1;
+
+  // Round down to a power of two so the index is a mask of the key
+  size_t power = 1;
+  while (power * 2 <= bucket_count) power *= 2;
+
+  buckets = std::vector<TTBucket>(power);
+  bucket_mask = power - 1;
+  generation = 0;
+}
+
+void TranspositionTable::clear() {
+  for (TTBucket& bucket : buckets) {
+    for (TTSlot& slot : bucket.slots) {
+      slot.key_xor_data.store(0, std::memory_order_relaxed);
+      slot.data.store(0, std::memory_order_relaxed);
+    }
+  }
+  generation = 0;
+}
+
+bool TranspositionTable::probe(uint64_t key, TTEntry& entry) const {
+  const TTBucket& bucket = buckets[key & bucket_mask];
+
+  for (const TTSlot& slot : bucket.slots) {
+    uint64_t data = slot.data.load(std::memory_order_relaxed);
+    uint64_t key_xor_data = slot.key_xor_data.load(std::memory_order_relaxed);
+
+    if ((key_xor_data ^ data) == key && data != 0) {
+      entry = unpack(data);
+      return entry.bound() != BOUND_NONE;
+    }
+  }
+
+  return false;
+}
+
+void TranspositionTable::store(uint64_t key, int32_t score, Move move, uint8_t depth, uint8_t bound) {
+  TTBucket& bucket = buckets[key & bucket_mask];
+  TTSlot* replace = &bucket.slots[0];
+  TTEntry old_entry = unpack(replace->data.load(std::memory_order_relaxed));
+  bool same_key = false;
+  int32_t worst_value = INT32_MAX;
+
+  for (TTSlot& slot : bucket.slots) {
+    uint64_t data = slot.data.load(std::memory_order_relaxed);
+    uint64_t key_xor_data = slot.key_xor_data.load(std::memory_order_relaxed);
+    TTEntry entry = unpack(data);
+
+    if ((key_xor_data ^ data) == key || entry.bound() == BOUND_NONE) {
+      replace = &slot;
+      old_entry = entry;
+      same_key = (key_xor_data ^ data) == key;
+      break;
+    }
+
+    // Prefer replacing shallow entries, and anything left over from an older search
+    uint8_t age_diff = (generation - entry.age()) & 0x3F;
+    int32_t value = entry.depth - 8 * age_diff;
+    if (value < worst_value) {
+      worst_value = value;
+      replace = &slot;
+      old_entry = entry;
+    }
+  }
+
+  // Keep a deeper result for the same position unless the new one is exact or it is stale
+  if (same_key && bound != BOUND_EXACT && depth + 2 < old_entry.depth && old_entry.age() == generation) {
+    return;
+  }
+
+  TTEntry new_entry;
+  new_entry.score = score;
+  new_entry.depth = depth;
+  new_entry.age_bound = (generation << 2) | bound;
+  // Don't lose the best move when a re-search of the same node didn't find one
+  new_entry.move = (move.move_data == 0 && same_key) ? old_entry.move : move;
+
+  uint64_t data = pack(new_entry);
+  replace->key_xor_data.store(key ^ data, std::memory_order_relaxed);
+  replace->data.store(data, std::memory_order_relaxed);
+}
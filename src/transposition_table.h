@@ -0,0 +1,85 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "move.h"
+
+enum Bound : uint8_t {
+  BOUND_NONE = 0,
+  BOUND_UPPER = 1,
+  BOUND_LOWER = 2,
+  BOUND_EXACT = 3
+};
+
+// Unpacked copy of a table slot, returned by probe
+struct TTEntry {
+  int32_t score;
+  Move move;
+  uint8_t depth;
+  // upper 6 bits: search generation, lower 2 bits: bound
+  uint8_t age_bound;
+
+  inline uint8_t bound() const { return age_bound & 0x3; }
+  inline uint8_t age() const { return age_bound >> 2; }
+};
+
+// Shared between search threads without locks. The key is stored xored with the data,
+// so a slot torn by two threads writing at once fails verification instead of being trusted.
+struct TTSlot {
+  std::atomic<uint64_t> key_xor_data{0};
+  std::atomic<uint64_t> data{0};
+};
+
+// 4 slots of 16 bytes, one bucket per cache line
+struct alignas(64) TTBucket {
+  std::array<TTSlot, 4> slots;
+};
+
+class TranspositionTable {
+
+public:
+
+  TranspositionTable(size_t size_mb = 16);
+
+  // Drops all entries, size is rounded down to a power of two number of buckets
+  void resize(size_t size_mb);
+  void clear();
+
+  // Called once per search so entries from older searches are replaced first
+  inline void new_search() {
+    generation = (generation + 1) & 0x3F;
+  }
+
+  // Fills entry and returns true on a hit
+  bool probe(uint64_t key, TTEntry& entry) const;
+  void store(uint64_t key, int32_t score, Move move, uint8_t depth, uint8_t bound);
+
+  inline void prefetch(uint64_t key) const {
+    __builtin_prefetch(&buckets[key & bucket_mask]);
+  }
+
+private:
+
+  std::vector<TTBucket> buckets;
+  uint64_t bucket_mask;
+  uint8_t generation;
+
+  static inline uint64_t pack(const TTEntry& entry) {
+    return (uint64_t)(uint32_t)entry.score | ((uint64_t)entry.move.move_data << 32) |
+           ((uint64_t)entry.depth << 48) | ((uint64_t)entry.age_bound << 56);
+  }
+
+  static inline TTEntry unpack(uint64_t data) {
+    TTEntry entry;
+    entry.score = (int32_t)(uint32_t)data;
+    entry.move.move_data = (uint16_t)(data >> 32);
+    entry.depth = (uint8_t)(data >> 48);
+    entry.age_bound = (uint8_t)(data >> 56);
+    return entry;
+  }
+
+};
+
+extern TranspositionTable TT;
@@ -0,0 +1,353 @@
+#include "uci.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "move.h"
+#include "move_generator.h"
+#include "nnue.h"
+#include "position.h"
+#include "search.h"
+#include "thread_pool.h"
+#include "transposition_table.h"
+
+namespace {
+
+constexpr size_t DEFAULT_HASH_MB = 16;
+constexpr size_t MAX_HASH_MB = 65536;
+constexpr size_t MAX_THREADS = 256;
+constexpr int64_t DEFAULT_MOVE_OVERHEAD_MS = 30;
+constexpr int64_t MAX_MOVE_OVERHEAD_MS = 5000;
+// Moves the remaining time is shared between when the GUI doesn't send movestogo
+constexpr int64_t DEFAULT_MOVES_TO_GO = 30;
+
+// Search margins exposed for tuning, set between searches only
+struct TunableOption {
+  const char* name;
+  int32_t SearchParams::* field;
+  int32_t min;
+  int32_t max;
+};
+
+constexpr std::array<TunableOption, 7> TUNABLE_OPTIONS = {{
+  {"ReverseFutilityMargin", &SearchParams::reverse_futility_margin, 0, 1000},
+  {"ReverseFutilityMaxDepth", &SearchParams::reverse_futility_max_depth, 0, 20},
+  {"FutilityBase", &SearchParams::futility_base, 0, 1000},
+  {"FutilityMargin", &SearchParams::futility_margin, 0, 1000},
+  {"FutilityMaxDepth", &SearchParams::futility_max_depth, 0, 20},
+  {"RazorMargin", &SearchParams::razor_margin, 0, 2000},
+  {"RazorMaxDepth", &SearchParams::razor_max_depth, 0, 20},
+}};
+
+uint8_t multi_pv = 1;
+int64_t move_overhead_ms = DEFAULT_MOVE_OVERHEAD_MS;
+std::chrono::steady_clock::time_point search_start;
+
+// The search thread writes info and bestmove lines while the input loop writes readyok,
+// every line goes out whole
+std::mutex output_mutex;
+
+// go infinite and go ponder must not send bestmove before stop or ponderhit,
+// even if the search has already ended
+std::mutex bestmove_mutex;
+std::condition_variable bestmove_cv;
+bool hold_bestmove = false;
+
+void send(const std::string& line) {
+  std::lock_guard<std::mutex> lock(output_mutex);
+  std::cout << line << std::endl;
+}
+
+void release_bestmove() {
+  {
+    std::lock_guard<std::mutex> lock(bestmove_mutex);
+    hold_bestmove = false;
+  }
+  bestmove_cv.notify_all();
+}
+
+uint64_t elapsed_ms() {
+  auto elapsed = std::chrono::steady_clock::now() - search_start;
+  return std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+}
+
+std::string score_to_string(int32_t score) {
+  int32_t mate = Search::mate_in(score);
+  return mate ? "mate " + std::to_string(mate) : "cp " + std::to_string(score);
+}
+
+// One info line per MultiPV line, called by the main search thread after every iteration
+void report_iteration(const Search& search) {
+  uint64_t time_ms = elapsed_ms();
+  uint64_t nodes = Threads.nodes_searched();
+
+  for (size_t i = 0; i < search.lines.size(); i++) {
+    const PVLine& line = search.lines[i];
+    std::ostringstream info;
+    info << "info depth " << (int)line.depth << " multipv " << i + 1 << " score " << score_to_string(line.score)
+         << " nodes " << nodes << " nps " << nodes * 1000 / std::max<uint64_t>(time_ms, 1) << " time " << time_ms
+         << " pv";
+    for (const Move& move : line.pv) info << " " << UCI::move_to_string(move);
+    send(info.str());
+  }
+}
+
+// Called on the search thread once the search has ended
+void report_bestmove(Move best_move) {
+  {
+    std::unique_lock<std::mutex> lock(bestmove_mutex);
+    bestmove_cv.wait(lock, [] { return !hold_bestmove; });
+  }
+
+  // No legal moves at the root
+  if (best_move.move_data == 0) {
+    send("bestmove 0000");
+    return;
+  }
+
+  std::string line = "bestmove " + UCI::move_to_string(best_move);
+  const std::vector<Move>& pv = Threads.best_thread().principal_variation;
+  if (pv.size() > 1 && pv[0] == best_move) line += " ponder " + UCI::move_to_string(pv[1]);
+  send(line);
+}
+
+// Waits for the last search, stopping it first if it is still going
+void finish_search() {
+  if (!Threads.is_searching()) return;
+  Threads.stop();
+  release_bestmove();
+  Threads.wait_for_search();
+}
+
+// position [startpos | fen <fen>] [moves <move>...]
+void set_position(Position& position, std::istringstream& is) {
+  std::string token;
+  is >> token;
+
+  if (token == "startpos") {
+    position = Position();
+    is >> token;
+  } else if (token == "fen") {
+    std::vector<std::string> fields;
+    while (is >> token && token != "moves") fields.push_back(token);
+    if (fields.size() < 4) return;
+
+    // The clocks are often left out
+    std::string fen = fields[0] + " " + fields[1] + " " + fields[2] + " " + fields[3];
+    fen += (fields.size() >= 6) ? " " + fields[4] + " " + fields[5] : " 0 1";
+    position = Position(fen);
+  } else {
+    return;
+  }
+
+  while (is >> token) {
+    Move move = UCI::string_to_move(token, position);
+    if (move.move_data == 0) break;
+    position.make_move(move);
+  }
+}
+
+// Time to spend on this move: an even share of the remaining time plus most of the increment,
+// never closer to the flag than the move overhead
+uint64_t allocate_time(int64_t time_left, int64_t increment, int64_t moves_to_go) {
+  if (moves_to_go <= 0) moves_to_go = DEFAULT_MOVES_TO_GO;
+  int64_t budget = time_left / moves_to_go + increment * 3 / 4;
+  budget = std::min(budget, time_left - move_overhead_ms);
+  return std::max<int64_t>(budget, 1);
+}
+
+// go [wtime btime winc binc movestogo movetime depth nodes infinite ponder]
+void go(const Position& position, std::istringstream& is) {
+  finish_search();
+
+  SearchLimits limits;
+  limits.multi_pv = multi_pv;
+  int64_t time_left[2] = {0, 0};
+  int64_t increment[2] = {0, 0};
+  int64_t moves_to_go = 0;
+  int64_t movetime = 0;
+  bool infinite = false;
+  bool ponder = false;
+
+  std::string token;
+  while (is >> token) {
+    if (token == "wtime") is >> time_left[WHITE];
+    else if (token == "btime") is >> time_left[BLACK];
+    else if (token == "winc") is >> increment[WHITE];
+    else if (token == "binc") is >> increment[BLACK];
+    else if (token == "movestogo") is >> moves_to_go;
+    else if (token == "movetime") is >> movetime;
+    else if (token == "depth") {
+      int depth;
+      is >> depth;
+      limits.depth = std::clamp(depth, 1, MAX_PLY - 1);
+    }
+    else if (token == "nodes") is >> limits.nodes;
+    else if (token == "infinite") infinite = true;
+    else if (token == "ponder") ponder = true;
+  }
+
+  uint8_t us = position.side_to_move;
+  if (movetime > 0) {
+    limits.movetime_ms = movetime;
+  } else if (!infinite && time_left[us] > 0) {
+    limits.movetime_ms = allocate_time(time_left[us], increment[us], moves_to_go);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(bestmove_mutex);
+    hold_bestmove = infinite || ponder;
+  }
+  search_start = std::chrono::steady_clock::now();
+  Threads.start_search(position, limits, ponder, report_bestmove);
+}
+
+// Spin option value clamped to [min, max], false if value doesn't start with a number
+bool parse_spin(const std::string& value, int64_t min, int64_t max, int64_t& result) {
+  std::istringstream is(value);
+  int64_t number;
+  if (!(is >> number)) return false;
+  result = std::clamp(number, min, max);
+  return true;
+}
+
+// setoption name <name> [value <value>], names may contain spaces. Invalid values are ignored.
+void set_option(std::istringstream& is) {
+  std::string token, name, value;
+  is >> token;
+  while (is >> token && token != "value") name += (name.empty() ? "" : " ") + token;
+  while (is >> token) value += (value.empty() ? "" : " ") + token;
+
+  int64_t number;
+  if (name == "Hash") {
+    if (parse_spin(value, 1, MAX_HASH_MB, number)) TT.resize(number);
+  } else if (name == "Threads") {
+    if (parse_spin(value, 1, MAX_THREADS, number)) Threads.set_threads(number);
+  } else if (name == "MultiPV") {
+    if (parse_spin(value, 1, 255, number)) multi_pv = number;
+  } else if (name == "Move Overhead") {
+    parse_spin(value, 0, MAX_MOVE_OVERHEAD_MS, move_overhead_ms);
+  } else if (name == "Clear Hash") {
+    TT.clear();
+  } else if (name == "EvalFile") {
+    send("info string " + value + (NNUE::load(value) ? " loaded" : " is not a valid network"));
+    Threads.clear_eval_caches();
+  } else if (name == "Use NNUE") {
+    NNUE::set_enabled(value == "true");
+    Threads.clear_eval_caches();
+  } else if (name != "Ponder") {
+    for (const TunableOption& option : TUNABLE_OPTIONS) {
+      if (name != option.name) continue;
+      if (parse_spin(value, option.min, option.max, number)) Params.*option.field = number;
+      return;
+    }
+    send("info string unknown option " + name);
+  }
+}
+
+void send_id() {
+  send("id name cheezy-engine");
+  send("id author Luke Nelson");
+  send("option name Hash type spin default " + std::to_string(DEFAULT_HASH_MB) + " min 1 max " +
+       std::to_string(MAX_HASH_MB));
+  send("option name Threads type spin default 1 min 1 max " + std::to_string(MAX_THREADS));
+  send("option name MultiPV type spin default 1 min 1 max 255");
+  send("option name Ponder type check default false");
+  send("option name Move Overhead type spin default " + std::to_string(DEFAULT_MOVE_OVERHEAD_MS) + " min 0 max " +
+       std::to_string(MAX_MOVE_OVERHEAD_MS));
+  send("option name Clear Hash type button");
+  send("option name EvalFile type string default " + std::string(NNUE::DEFAULT_EVAL_FILE));
+  send("option name Use NNUE type check default true");
+  const SearchParams defaults;
+  for (const TunableOption& option : TUNABLE_OPTIONS) {
+    send("option name " + std::string(option.name) + " type spin default " + std::to_string(defaults.*option.field) +
+         " min " + std::to_string(option.min) + " max " + std::to_string(option.max));
+  }
+  send("uciok");
+}
+
+}
+
+namespace UCI {
+
+void loop() {
+  Threads.set_iteration_callback(report_iteration);
+  Position position;
+
+  std::string line;
+  while (std::getline(std::cin, line)) {
+    std::istringstream is(line);
+    std::string command;
+    is >> command;
+
+    if (command == "uci") {
+      send_id();
+    } else if (command == "isready") {
+      send("readyok");
+    } else if (command == "ucinewgame") {
+      finish_search();
+      TT.clear();
+      Threads.clear_history();
+      Threads.clear_eval_caches();
+      Threads.clear_pawn_tables();
+    } else if (command == "position") {
+      finish_search();
+      set_position(position, is);
+    } else if (command == "go") {
+      go(position, is);
+    } else if (command == "stop") {
+      Threads.stop();
+      release_bestmove();
+    } else if (command == "ponderhit") {
+      Threads.ponder_hit();
+      release_bestmove();
+    } else if (command == "setoption") {
+      finish_search();
+      set_option(is);
+    } else if (command == "quit") {
+      break;
+    }
+  }
+
+  finish_search();
+  Threads.set_iteration_callback(nullptr);
+}
+
+std::string move_to_string(Move move) {
+  std::string move_str = "";
+  uint8_t from_sq = move.get_from_sq();
+  uint8_t to_sq = move.get_to_sq();
+  uint8_t flags = move.get_flags();
+
+  move_str += (char)('a' + from_sq % 8);
+  move_str += (char)('1' + from_sq / 8);
+  move_str += (char)('a' + to_sq % 8);
+  move_str += (char)('1' + to_sq / 8);
+
+  if (flags == PROMO_KNIGHT) move_str += 'n';
+  if (flags == PROMO_BISHOP) move_str += 'b';
+  if (flags == PROMO_ROOK) move_str += 'r';
+  if (flags == PROMO_QUEEN) move_str += 'q';
+
+  return move_str;
+}
+
+Move string_to_move(const std::string& move_str, const Position& pos) {
+  MoveList legal_moves;
+  legal_moves.generate(pos);
+
+  for (int i = 0; i < legal_moves.count; i++) {
+    Move legal_move = legal_moves.moves[i].move;
+    if (move_str == move_to_string(legal_move)) return legal_move;
+  }
+
+  return Move();
+}
+
+} // namespace UCI
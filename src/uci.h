@@ -0,0 +1,18 @@
+#pragma once
+#include <string>
+#include "move.h"
+#include "position.h"
+
+namespace UCI {
+
+// Reads commands from stdin until quit. Searches run on a thread of their own,
+// so stop, ponderhit and isready are answered while one is going.
+void loop();
+
+// Long algebraic notation, e.g. e2e4 or e7e8q
+std::string move_to_string(Move move);
+
+// Empty move if move_str isn't a legal move in pos
+Move string_to_move(const std::string& move_str, const Position& pos);
+
+} // namespace UCI
@@ -0,0 +1,58 @@
+#include "zobrist.h"
+#include <array>
+#include <cstdint>
+
+namespace {
+
+// splitmix64, fixed seed so keys are identical between runs
+uint64_t next_random(uint64_t& state) {
+  uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+uint64_t rng_state = 0x2545F4914F6CDD1DULL;
+
+std::array<std::array<uint64_t, 64>, 12> init_piece_keys() {
+  std::array<std::array<uint64_t, 64>, 12> keys;
+  for (int piece = 0; piece < 12; piece++) {
+    for (int sq = 0; sq < 64; sq++) {
+      keys[piece][sq] = next_random(rng_state);
+    }
+  }
+  return keys;
+}
+
+std::array<uint64_t, 16> init_castling_keys() {
+  std::array<uint64_t, 16> keys;
+  // Combined rights are the xor of the single rights, so updates can xor old and new
+  std::array<uint64_t, 4> single = {next_random(rng_state), next_random(rng_state),
+                                    next_random(rng_state), next_random(rng_state)};
+  for (int rights = 0; rights < 16; rights++) {
+    keys[rights] = 0;
+    for (int bit = 0; bit < 4; bit++) {
+      if (rights & (1 << bit)) keys[rights] ^= single[bit];
+    }
+  }
+  return keys;
+}
+
+std::array<uint64_t, 8> init_en_passant_keys() {
+  std::array<uint64_t, 8> keys;
+  for (int file = 0; file < 8; file++) {
+    keys[file] = next_random(rng_state);
+  }
+  return keys;
+}
+
+}
+
+namespace Zobrist {
+
+const std::array<std::array<uint64_t, 64>, 12> PIECE_KEYS = init_piece_keys();
+const std::array<uint64_t, 16> CASTLING_KEYS = init_castling_keys();
+const std::array<uint64_t, 8> EN_PASSANT_KEYS = init_en_passant_keys();
+const uint64_t SIDE_KEY = next_random(rng_state);
+
+} // namespace Zobrist
@@ -0,0 +1,15 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+namespace Zobrist {
+
+// [piece_type][square]
+extern const std::array<std::array<uint64_t, 64>, 12> PIECE_KEYS;
+// Indexed by the 4 bit castling rights
+extern const std::array<uint64_t, 16> CASTLING_KEYS;
+// Indexed by the file of the en passant square
+extern const std::array<uint64_t, 8> EN_PASSANT_KEYS;
+extern const uint64_t SIDE_KEY;
+
+} // namespace Zobrist